@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+#include "FlatHashMap.h"
+#include "ParallelUtil.h"
+
+namespace
+{
+   //! \brief Splits the hash space into a power of two number of partitions, using the topmost bits of the hash
+   struct HashPartitioning
+   {
+      explicit HashPartitioning(size_t minPartitions)
+      {
+         while ((size_t{ 1 } << _bits) < minPartitions) _bits++;
+      }
+
+      size_t NumPartitions() const { return size_t{ 1 } << _bits; }
+
+      size_t PartitionOf(uint64_t hash) const
+      {
+         return _bits ? static_cast<size_t>(hash >> (64 - _bits)) : 0;
+      }
+
+      size_t _bits = 0;
+   };
+}
+
+//! \brief Runs a parallel hash aggregation (group-by) with the task system. Each task aggregates a chunk of the input into
+//!        thread-local open-addressing tables, one per hash partition. The partitions are then merged in parallel,
+//!        every merge task owns a whole partition so no synchronization is needed
+//! \param begin Start of the input range
+//! \param end End of the input range
+//! \param keyFunc Functor that returns the grouping key of an element
+//! \param init Initial value of the aggregate of each group
+//! \param aggregate Functor (Acc&, const Elem&) that adds an element to the aggregate of its group
+//! \param combine Functor (Acc&, const Acc&) that combines two partial aggregates of the same group
+//! \returns Pairs of key and aggregate for each group, in no particular order
+template<
+   typename RndIter,
+   typename KeyFunc,
+   typename Acc,
+   typename Aggregate,
+   typename Combine
+>
+auto ParallelGroupBy(
+   RndIter begin,
+   RndIter end,
+   KeyFunc keyFunc,
+   Acc init,
+   Aggregate aggregate,
+   Combine combine)
+{
+   using Key_t = std::decay_t<decltype(keyFunc(*begin))>;
+   using Table_t = FlatHashMap<Key_t, Acc>;
+   static constexpr size_t MinChunkSize = 1 << 14;
+
+   const auto count = static_cast<size_t>(std::distance(begin, end));
+   const auto concurrency = task::GetMaxConcurrency();
+   const auto numChunks = std::max(size_t{ 1 }, std::min(concurrency, count / MinChunkSize));
+   const HashPartitioning partitioning(numChunks > 1 ? concurrency * 4 : 1);
+   const auto numPartitions = partitioning.NumPartitions();
+
+   //Local aggregation into one table per chunk and partition
+   std::vector<std::vector<Table_t>> localTables(numChunks, std::vector<Table_t>(numPartitions));
+   std::vector<std::future<void>> futures;
+   futures.reserve(std::max(numChunks, numPartitions));
+   const auto chunkSize = count / numChunks;
+   for (size_t chunk = 0; chunk < numChunks; chunk++)
+   {
+      auto chunkBegin = begin + chunk * chunkSize;
+      auto chunkEnd = (chunk == numChunks - 1) ? end : chunkBegin + chunkSize;
+      futures.push_back(task::AddAwaitableTask([&, chunk, chunkBegin, chunkEnd]()
+      {
+         auto& tables = localTables[chunk];
+         for (auto iter = chunkBegin; iter != chunkEnd; ++iter)
+         {
+            auto key = keyFunc(*iter);
+            auto hash = Table_t::HashOf(key);
+            aggregate(tables[partitioning.PartitionOf(hash)].FindOrInsert(key, hash, init), *iter);
+         }
+      }));
+   }
+   AwaitAllFutures(futures);
+
+   //Merge each partition independently
+   futures.clear();
+   for (size_t partition = 0; partition < numPartitions; partition++)
+   {
+      futures.push_back(task::AddAwaitableTask([&, partition]()
+      {
+         auto& target = localTables[0][partition];
+         for (size_t chunk = 1; chunk < numChunks; chunk++)
+         {
+            localTables[chunk][partition].ForEach([&](const Key_t& key, const Acc& value, uint64_t hash)
+            {
+               combine(target.FindOrInsert(key, hash, init), value);
+            });
+            localTables[chunk][partition] = Table_t();
+         }
+      }));
+   }
+   AwaitAllFutures(futures);
+
+   //Every partition copies its groups into its own slice of the results
+   std::vector<size_t> offsets(numPartitions + 1, 0);
+   for (size_t partition = 0; partition < numPartitions; partition++)
+   {
+      offsets[partition + 1] = offsets[partition] + localTables[0][partition].Size();
+   }
+   std::vector<std::pair<Key_t, Acc>> results(offsets[numPartitions]);
+   futures.clear();
+   for (size_t partition = 0; partition < numPartitions; partition++)
+   {
+      futures.push_back(task::AddAwaitableTask([&, partition]()
+      {
+         auto out = results.begin() + offsets[partition];
+         localTables[0][partition].ForEach([&](const Key_t& key, const Acc& value, uint64_t)
+         {
+            out->first = key;
+            out->second = value;
+            ++out;
+         });
+      }));
+   }
+   AwaitAllFutures(futures);
+   return results;
+}
+
+//! \brief Counts the occurrences of each distinct value in the given range in parallel
+//! \param begin Start of the range
+//! \param end End of the range
+//! \returns Pairs of value and number of occurrences, in no particular order
+template<typename RndIter>
+auto ParallelHistogram(RndIter begin, RndIter end)
+{
+   using Value_t = std::decay_t<decltype(*begin)>;
+   return ParallelGroupBy(
+      begin, end,
+      [](const Value_t& val) { return val; },
+      size_t{ 0 },
+      [](size_t& count, const Value_t&) { count++; },
+      [](size_t& count, size_t other) { count += other; });
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "ArenaAllocator.h"
+
+#include <cstdint>
+#include <vector>
+#include <future>
+
+#include "TaskSystem.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+   constexpr size_t SmallPageSize = 4096;
+   constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+   size_t RoundUp(size_t val, size_t multiple)
+   {
+      return ((val + multiple - 1) / multiple) * multiple;
+   }
+
+#ifdef _WIN32
+   void* MapMemory(size_t& size, mem::PageMode pageMode, bool& explicitHugePages)
+   {
+      explicitHugePages = false;
+      if (pageMode == mem::PageMode::ExplicitHugePages)
+      {
+         //Requires the SeLockMemoryPrivilege, otherwise we fall back to regular pages
+         auto largePageSize = GetLargePageMinimum();
+         if (largePageSize)
+         {
+            auto largeSize = RoundUp(size, largePageSize);
+            auto memory = VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (memory)
+            {
+               size = largeSize;
+               explicitHugePages = true;
+               return memory;
+            }
+         }
+      }
+      //Windows has no transparent huge pages
+      size = RoundUp(size, SmallPageSize);
+      return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+   }
+
+   void UnmapMemory(void* memory, size_t)
+   {
+      VirtualFree(memory, 0, MEM_RELEASE);
+   }
+#else
+   void* MapMemory(size_t& size, mem::PageMode pageMode, bool& explicitHugePages)
+   {
+      explicitHugePages = false;
+      if (pageMode == mem::PageMode::Default)
+      {
+         size = RoundUp(size, SmallPageSize);
+         auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         return (memory == MAP_FAILED) ? nullptr : memory;
+      }
+
+      size = RoundUp(size, HugePageSize);
+#ifdef MAP_HUGETLB
+      if (pageMode == mem::PageMode::ExplicitHugePages)
+      {
+         auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+         if (memory != MAP_FAILED)
+         {
+            explicitHugePages = true;
+            return memory;
+         }
+      }
+#endif
+      auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (memory == MAP_FAILED) return nullptr;
+#ifdef MADV_HUGEPAGE
+      //Only a hint, the kernel may not support transparent huge pages
+      madvise(memory, size, MADV_HUGEPAGE);
+#endif
+      return memory;
+   }
+
+   void UnmapMemory(void* memory, size_t size)
+   {
+      munmap(memory, size);
+   }
+#endif
+}
+
+namespace mem
+{
+
+   Arena::Arena(size_t capacity, PageMode pageMode, bool parallelFirstTouch) :
+      _capacity(capacity),
+      _mappedSize(capacity ? capacity : 1)
+   {
+      _memory = static_cast<char*>(MapMemory(_mappedSize, pageMode, _explicitHugePages));
+      if (!_memory) throw std::bad_alloc();
+      if (parallelFirstTouch) ParallelFirstTouch(_memory, _mappedSize, task::GetMaxConcurrency());
+   }
+
+   Arena::~Arena()
+   {
+      UnmapMemory(_memory, _mappedSize);
+   }
+
+   void* Arena::Allocate(size_t bytes, size_t alignment)
+   {
+      auto offset = _offset.load();
+      size_t start, end;
+      do
+      {
+         auto address = reinterpret_cast<uintptr_t>(_memory) + offset;
+         start = offset + static_cast<size_t>(RoundUp(address, alignment) - address);
+         end = start + bytes;
+         if (end > _capacity || end < start) throw std::bad_alloc();
+      } while (!_offset.compare_exchange_weak(offset, end));
+      return _memory + start;
+   }
+
+   void Arena::Deallocate(void* ptr, size_t bytes)
+   {
+      auto start = static_cast<size_t>(static_cast<char*>(ptr) - _memory);
+      auto end = start + bytes;
+      //Fails without harm if something else was allocated in the meantime
+      _offset.compare_exchange_strong(end, start);
+   }
+
+   void Arena::Reset()
+   {
+      _offset = 0;
+   }
+
+   void ParallelFirstTouch(void* memory, size_t bytes, size_t numChunks)
+   {
+      if (!bytes) return;
+      if (!numChunks) numChunks = 1;
+      auto chunkSize = RoundUp((bytes + numChunks - 1) / numChunks, SmallPageSize);
+      auto begin = static_cast<char*>(memory);
+
+      std::vector<std::future<void>> futures;
+      futures.reserve(numChunks);
+      for (size_t chunk = 0; chunk < numChunks; chunk++)
+      {
+         auto chunkBegin = chunk * chunkSize;
+         if (chunkBegin >= bytes) break;
+         auto chunkEnd = (chunk == numChunks - 1 || chunkBegin + chunkSize > bytes) ? bytes : chunkBegin + chunkSize;
+         futures.push_back(task::AddAwaitableTask([=]()
+         {
+            for (auto offset = chunkBegin; offset < chunkEnd; offset += SmallPageSize)
+            {
+               static_cast<volatile char*>(begin)[offset] = 0;
+            }
+         }));
+      }
+      for (auto& f : futures) task::Await(f);
+   }
+
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace mem
+{
+
+   //! \brief How the memory of an arena is backed
+   enum class PageMode
+   {
+      //! \brief Regular pages
+      Default,
+      //! \brief Regular mapping that the OS is asked to back with huge pages (madvise(MADV_HUGEPAGE) on Linux)
+      TransparentHugePages,
+      //! \brief Explicit huge pages (MAP_HUGETLB on Linux, MEM_LARGE_PAGES on Windows). Falls back to transparent
+      //!        huge pages if the system has none reserved
+      ExplicitHugePages
+   };
+
+   //! \brief A fixed-size memory arena for large, short-lived buffers like sort inputs and merge temporaries. Allocation
+   //!        is a thread-safe pointer bump. Memory is only given back if it is the most recent allocation, otherwise it
+   //!        is reclaimed by Reset() or when the arena is destroyed
+   class Arena
+   {
+   public:
+      //! \param capacity Size of the arena in bytes
+      //! \param pageMode Page backing of the arena
+      //! \param parallelFirstTouch Touch all pages on the task system right away, so the page faults are taken in
+      //!                           parallel up front instead of by whoever writes the memory first
+      explicit Arena(size_t capacity, PageMode pageMode = PageMode::TransparentHugePages, bool parallelFirstTouch = false);
+      ~Arena();
+
+      Arena(const Arena&) = delete;
+      Arena& operator=(const Arena&) = delete;
+
+      //! \brief Allocates memory from the arena
+      //! \throws std::bad_alloc if the arena is exhausted
+      void* Allocate(size_t bytes, size_t alignment);
+      //! \brief Gives memory back to the arena. Only has an effect for the most recent allocation
+      void Deallocate(void* ptr, size_t bytes);
+      //! \brief Frees all allocations at once
+      void Reset();
+
+      size_t Capacity() const { return _capacity; }
+      size_t Used() const { return _offset; }
+      //! \brief True if the arena is backed by explicit huge pages
+      bool HasExplicitHugePages() const { return _explicitHugePages; }
+   private:
+      char* _memory = nullptr;
+      size_t _capacity = 0;
+      size_t _mappedSize = 0;
+      bool _explicitHugePages = false;
+      std::atomic<size_t> _offset{ 0 };
+   };
+
+   //! \brief Touches every page of the given memory with one task per chunk, so the page faults are spread over the
+   //!        threads of the task system. Pass the chunk count of the algorithm that consumes the memory to split it
+   //!        along the same boundaries. Tasks are not bound to threads, so this does not control NUMA placement
+   //! \param memory Start of the memory
+   //! \param bytes Size of the memory
+   //! \param numChunks Number of equally sized chunks
+   void ParallelFirstTouch(void* memory, size_t bytes, size_t numChunks);
+
+   //! \brief STL allocator that allocates from an arena. Elements that are constructed without arguments are default-
+   //!        initialized, so e.g. std::vector<size_t, ArenaAllocator<size_t>>(count) does not zero-fill its memory on a
+   //!        single thread and the first write decides where the pages end up
+   template<typename T>
+   class ArenaAllocator
+   {
+   public:
+      using value_type = T;
+
+      explicit ArenaAllocator(Arena& arena) :
+         _arena(&arena) {}
+
+      template<typename U>
+      ArenaAllocator(const ArenaAllocator<U>& other) :
+         _arena(other.GetArena()) {}
+
+      T* allocate(size_t count)
+      {
+         return static_cast<T*>(_arena->Allocate(count * sizeof(T), alignof(T)));
+      }
+
+      void deallocate(T* ptr, size_t count)
+      {
+         _arena->Deallocate(ptr, count * sizeof(T));
+      }
+
+      template<typename U>
+      void construct(U* ptr)
+      {
+         ::new (static_cast<void*>(ptr)) U;
+      }
+
+      template<typename U, typename... Args>
+      void construct(U* ptr, Args&&... args)
+      {
+         ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+      }
+
+      Arena* GetArena() const { return _arena; }
+   private:
+      Arena* _arena;
+   };
+
+   template<typename T, typename U>
+   bool operator==(const ArenaAllocator<T>& l, const ArenaAllocator<U>& r)
+   {
+      return l.GetArena() == r.GetArena();
+   }
+
+   template<typename T, typename U>
+   bool operator!=(const ArenaAllocator<T>& l, const ArenaAllocator<U>& r)
+   {
+      return !(l == r);
+   }
+
+}
\ No newline at end of file
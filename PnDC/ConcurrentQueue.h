@@ -2,6 +2,7 @@
 
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 
 //! \brief A concurrent queue that can be accessed from multiple threads
 template<typename T>
@@ -36,4 +37,110 @@ public:
 private:
    std::queue<T> _queue;
    mutable std::mutex _lock;
+};
+
+//! \brief A concurrent queue with a maximum capacity. Enqueue blocks while the queue is full and Dequeue blocks while
+//!        it is empty, which gives producers backpressure from slow consumers. Producers that must not block can reserve
+//!        a slot up front instead. After Close(), no more elements are accepted and consumers drain the remaining elements
+template<typename T>
+class BoundedConcurrentQueue
+{
+public:
+   explicit BoundedConcurrentQueue(size_t capacity) :
+      _capacity(capacity ? capacity : 1) {}
+
+   //! \brief Adds an element, blocks while the queue is full
+   //! \returns False if the queue was closed, in which case the element is dropped
+   bool Enqueue(T elem)
+   {
+      std::unique_lock<std::mutex> lock(_lock);
+      _notFull.wait(lock, [this]() { return _closed || _queue.size() + _reserved < _capacity; });
+      if (_closed) return false;
+      _queue.push(std::move(elem));
+      _notEmpty.notify_one();
+      return true;
+   }
+
+   //! \brief Removes an element, blocks while the queue is empty and not closed
+   //! \param elem Receives the element
+   //! \returns False if the queue is closed and empty
+   bool Dequeue(T& elem)
+   {
+      std::unique_lock<std::mutex> lock(_lock);
+      _notEmpty.wait(lock, [this]() { return _closed || !_queue.empty(); });
+      if (_queue.empty()) return false;
+      elem = std::move(_queue.front());
+      _queue.pop();
+      _notFull.notify_one();
+      return true;
+   }
+
+   //! \brief Reserves a slot for an element without blocking
+   //! \returns False if the queue is full or closed
+   bool TryReserve()
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      if (_closed || _queue.size() + _reserved >= _capacity) return false;
+      _reserved++;
+      return true;
+   }
+
+   //! \brief Adds an element into a slot reserved by TryReserve(). Never blocks
+   void EnqueueReserved(T elem)
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      _reserved--;
+      _queue.push(std::move(elem));
+      _notEmpty.notify_one();
+   }
+
+   //! \brief Gives back a slot reserved by TryReserve()
+   void CancelReservation()
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      _reserved--;
+      _notFull.notify_one();
+   }
+
+   //! \brief Removes an element without blocking
+   //! \param elem Receives the element
+   //! \returns False if the queue is empty
+   bool TryDequeue(T& elem)
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      if (_queue.empty()) return false;
+      elem = std::move(_queue.front());
+      _queue.pop();
+      _notFull.notify_one();
+      return true;
+   }
+
+   //! \brief Closes the queue and wakes up all waiting producers and consumers
+   void Close()
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      _closed = true;
+      _notFull.notify_all();
+      _notEmpty.notify_all();
+   }
+
+   bool IsClosed() const
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      return _closed;
+   }
+
+   //! \brief Returns true if the queue is closed and all elements have been removed
+   bool IsDrained() const
+   {
+      std::lock_guard<std::mutex> guard(_lock);
+      return _closed && _queue.empty() && !_reserved;
+   }
+private:
+   std::queue<T> _queue;
+   size_t _capacity;
+   size_t _reserved = 0;
+   bool _closed = false;
+   mutable std::mutex _lock;
+   std::condition_variable _notFull, _notEmpty;
 };
\ No newline at end of file
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <memory>
+
+#include "MathUtil.h"
+#include "TaskSystem.h"
+#include "DefaultInitAllocator.h"
+
+namespace data
+{
+
+   //! \brief Shape of the generated data
+   enum class Distribution
+   {
+      Uniform,
+      Sorted,
+      Reverse,
+      NearlySorted,
+      FewUnique,
+      Zipf,
+      AllEqual
+   };
+
+   constexpr Distribution AllDistributions[] = {
+      Distribution::Uniform,
+      Distribution::Sorted,
+      Distribution::Reverse,
+      Distribution::NearlySorted,
+      Distribution::FewUnique,
+      Distribution::Zipf,
+      Distribution::AllEqual
+   };
+
+   inline const char* GetName(Distribution distribution)
+   {
+      switch (distribution)
+      {
+      case Distribution::Uniform: return "Uniform";
+      case Distribution::Sorted: return "Sorted";
+      case Distribution::Reverse: return "Reverse";
+      case Distribution::NearlySorted: return "Nearly sorted";
+      case Distribution::FewUnique: return "Few unique";
+      case Distribution::Zipf: return "Zipf";
+      case Distribution::AllEqual: return "All equal";
+      default: return "Unknown";
+      }
+   }
+
+   //! \brief Generated numbers. The vector is not zero-filled on construction, so its pages are first touched by the
+   //!        parallel generator tasks
+   using Numbers = std::vector<size_t, mem::DefaultInitAllocator<size_t>>;
+
+   //! \brief Tuning parameters for the distributions
+   struct DistributionParams
+   {
+      DistributionParams() :
+         _maxValue(1000),
+         _uniqueValues(16),
+         _swapProbability(0.01),
+         _zipfExponent(1.0) {}
+
+      //! \brief All generated values lie in [0, _maxValue]
+      size_t _maxValue;
+      //! \brief Number of distinct values for Distribution::FewUnique
+      size_t _uniqueValues;
+      //! \brief Probability of an element being swapped with a close neighbour for Distribution::NearlySorted
+      double _swapProbability;
+      //! \brief Exponent of the Zipf distribution. Larger values mean more skew
+      double _zipfExponent;
+   };
+
+   //! \brief Counter-based random number generator built on SplitMix64. The random stream is fully determined by
+   //!        the seed and the counter, so any element of a sequence can be generated independently of the others
+   class CounterRng
+   {
+   public:
+      CounterRng(uint64_t seed, uint64_t counter) :
+         _state(math::Mix64(seed ^ math::Mix64(counter))) {}
+
+      uint64_t Next()
+      {
+         _state += 0x9E3779B97F4A7C15ull;
+         return math::Mix64(_state);
+      }
+
+      //! \brief Returns a uniformly distributed number in [0, 1)
+      double NextDouble()
+      {
+         return (Next() >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+      //! \brief Returns a uniformly distributed number in [0, maxValue]
+      size_t NextInRange(size_t maxValue)
+      {
+         if (maxValue == std::numeric_limits<size_t>::max()) return static_cast<size_t>(Next());
+         return static_cast<size_t>(Next() % (static_cast<uint64_t>(maxValue) + 1));
+      }
+   private:
+      uint64_t _state;
+   };
+
+   //! \brief Samples ranks in [1, numElements] from a Zipf distribution using rejection-inversion sampling
+   //!        (Hoermann & Derflinger). Needs no lookup table, so it also works for huge value ranges
+   class ZipfSampler
+   {
+   public:
+      ZipfSampler(size_t numElements, double exponent) :
+         _numElements(static_cast<double>(numElements)),
+         _exponent(exponent)
+      {
+         _hIntegralX1 = HIntegral(1.5) - 1.0;
+         _hIntegralN = HIntegral(_numElements + 0.5);
+         _s = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+      }
+
+      size_t Sample(CounterRng& rng) const
+      {
+         while (true)
+         {
+            auto u = _hIntegralN + rng.NextDouble() * (_hIntegralX1 - _hIntegralN);
+            auto x = HIntegralInverse(u);
+            auto k = std::min(std::max(std::floor(x + 0.5), 1.0), _numElements);
+            if (k - x <= _s || u >= HIntegral(k + 0.5) - H(k)) return ToRank(k);
+         }
+      }
+   private:
+      //! \brief Ranks close to 2^64 do not fit into size_t once they are rounded to a double
+      static size_t ToRank(double k)
+      {
+         constexpr auto MaxRank = std::numeric_limits<size_t>::max();
+         return (k >= static_cast<double>(MaxRank)) ? MaxRank : static_cast<size_t>(k);
+      }
+
+      double H(double x) const
+      {
+         return std::exp(-_exponent * std::log(x));
+      }
+
+      double HIntegral(double x) const
+      {
+         auto logX = std::log(x);
+         return Helper2((1.0 - _exponent) * logX) * logX;
+      }
+
+      double HIntegralInverse(double x) const
+      {
+         auto t = std::max(x * (1.0 - _exponent), -1.0);
+         return std::exp(Helper1(t) * x);
+      }
+
+      //! \brief log(1 + x) / x, stable for x close to 0
+      static double Helper1(double x)
+      {
+         if (std::abs(x) > 1e-8) return std::log1p(x) / x;
+         return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+      }
+
+      //! \brief (exp(x) - 1) / x, stable for x close to 0
+      static double Helper2(double x)
+      {
+         if (std::abs(x) > 1e-8) return std::expm1(x) / x;
+         return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+      }
+
+      double _numElements;
+      double _exponent;
+      double _hIntegralX1, _hIntegralN, _s;
+   };
+
+   namespace
+   {
+      //! \brief Data is generated in chunks of this size. The chunking only depends on the number of elements, never
+      //!        on the number of threads, so the output is reproducible on every machine
+      constexpr size_t GenerationChunkSize = 1 << 16;
+      constexpr size_t NearlySortedSwapDistance = 8;
+
+      //! \brief Value at 'idx' of an ascending sequence of 'count' values that covers [0, maxValue]
+      inline size_t SortedValue(size_t idx, size_t count, size_t maxValue)
+      {
+         auto step = (static_cast<double>(maxValue) + 1.0) / static_cast<double>(count);
+         auto value = static_cast<double>(idx) * step;
+         //Compare before converting, the value can exceed the range of size_t if maxValue is close to its maximum
+         return (value >= static_cast<double>(maxValue)) ? maxValue : static_cast<size_t>(value);
+      }
+
+      template<typename RndIter>
+      void GenerateChunk(
+         RndIter begin,
+         size_t chunkStart,
+         size_t chunkEnd,
+         size_t count,
+         Distribution distribution,
+         uint64_t seed,
+         const DistributionParams& params,
+         const ZipfSampler* zipf)
+      {
+         for (auto idx = chunkStart; idx < chunkEnd; idx++)
+         {
+            CounterRng rng(seed, idx);
+            size_t value = 0;
+            switch (distribution)
+            {
+            case Distribution::Uniform:
+               value = rng.NextInRange(params._maxValue);
+               break;
+            case Distribution::Sorted:
+            case Distribution::NearlySorted:
+               value = SortedValue(idx, count, params._maxValue);
+               break;
+            case Distribution::Reverse:
+               value = SortedValue(count - 1 - idx, count, params._maxValue);
+               break;
+            case Distribution::FewUnique:
+            {
+               auto uniqueValues = std::max(params._uniqueValues, size_t{ 1 });
+               auto bucket = static_cast<size_t>(rng.Next() % uniqueValues);
+               value = (uniqueValues > 1) ? SortedValue(bucket, uniqueValues - 1, params._maxValue) : 0;
+               break;
+            }
+            case Distribution::Zipf:
+               //Rank 1 is the most frequent one
+               value = zipf->Sample(rng) - 1;
+               break;
+            case Distribution::AllEqual:
+               value = params._maxValue / 2;
+               break;
+            }
+            *(begin + idx) = value;
+         }
+
+         if (distribution != Distribution::NearlySorted) return;
+
+         //Swap a few elements with close neighbours. Swaps never cross chunk boundaries, so chunks stay independent
+         for (auto idx = chunkStart; idx < chunkEnd; idx++)
+         {
+            CounterRng rng(~seed, idx);
+            if (rng.NextDouble() >= params._swapProbability) continue;
+            auto other = idx + 1 + static_cast<size_t>(rng.Next() % NearlySortedSwapDistance);
+            if (other >= chunkEnd) continue;
+            std::iter_swap(begin + idx, begin + other);
+         }
+      }
+   }
+
+   //! \brief Fills the given range with numbers of the given distribution. Generation runs in parallel on the task system,
+   //!        the result only depends on the seed, the parameters and the size of the range
+   //! \param begin Start of the range
+   //! \param end End of the range
+   //! \param distribution Distribution of the numbers
+   //! \param seed Seed for the random number generator
+   //! \param params Optional parameters of the distribution
+   template<typename RndIter>
+   void GenerateInto(
+      RndIter begin,
+      RndIter end,
+      Distribution distribution,
+      uint64_t seed,
+      const DistributionParams& params = DistributionParams())
+   {
+      auto count = static_cast<size_t>(std::distance(begin, end));
+      if (!count) return;
+
+      //The sampler precomputes a few logarithms, only pay for it if it is needed
+      std::unique_ptr<ZipfSampler> zipf;
+      if (distribution == Distribution::Zipf)
+      {
+         auto numValues = (params._maxValue == std::numeric_limits<size_t>::max()) ? params._maxValue : params._maxValue + 1;
+         zipf = std::make_unique<ZipfSampler>(numValues, params._zipfExponent);
+      }
+      auto numChunks = (count + GenerationChunkSize - 1) / GenerationChunkSize;
+      auto numTasks = std::min(numChunks, task::GetMaxConcurrency());
+
+      std::vector<std::future<void>> futures;
+      futures.reserve(numTasks);
+      for (size_t taskIdx = 0; taskIdx < numTasks; taskIdx++)
+      {
+         futures.push_back(task::AddAwaitableTask([=, &params, zipfSampler = zipf.get()]()
+         {
+            for (auto chunk = taskIdx; chunk < numChunks; chunk += numTasks)
+            {
+               auto chunkStart = chunk * GenerationChunkSize;
+               auto chunkEnd = std::min(chunkStart + GenerationChunkSize, count);
+               GenerateChunk(begin, chunkStart, chunkEnd, count, distribution, seed, params, zipfSampler);
+            }
+         }));
+      }
+      for (auto& f : futures)
+      {
+         task::Await(f);
+         f.get();
+      }
+   }
+
+   //! \brief Generates 'count' numbers of the given distribution
+   //! \param count Number of elements
+   //! \param distribution Distribution of the numbers
+   //! \param seed Seed for the random number generator
+   //! \param params Optional parameters of the distribution
+   //! \returns Generated numbers
+   inline Numbers GenerateNumbers(
+      size_t count,
+      Distribution distribution,
+      uint64_t seed,
+      const DistributionParams& params = DistributionParams())
+   {
+      Numbers ret(count);
+      GenerateInto(ret.begin(), ret.end(), distribution, seed, params);
+      return ret;
+   }
+
+   //! \brief Generates 'count' numbers of the given distribution into a vector with a custom allocator. With 
+   //!        mem::ArenaAllocator the vector is not zero-filled up front, so its pages are first touched by the 
+   //!        parallel generator tasks
+   //! \param count Number of elements
+   //! \param distribution Distribution of the numbers
+   //! \param seed Seed for the random number generator
+   //! \param allocator Allocator for the vector
+   //! \param params Optional parameters of the distribution
+   //! \returns Generated numbers
+   template<typename Alloc>
+   std::vector<size_t, Alloc> GenerateNumbers(
+      size_t count,
+      Distribution distribution,
+      uint64_t seed,
+      const Alloc& allocator,
+      const DistributionParams& params = DistributionParams())
+   {
+      std::vector<size_t, Alloc> ret(count, allocator);
+      GenerateInto(ret.begin(), ret.end(), distribution, seed, params);
+      return ret;
+   }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+namespace mem
+{
+
+   //! \brief std::allocator that default-initializes elements instead of value-initializing them. A vector of trivial
+   //!        types is then not zero-filled on construction, its pages are first touched by whoever writes the elements
+   template<typename T>
+   class DefaultInitAllocator : public std::allocator<T>
+   {
+   public:
+      template<typename U>
+      struct rebind
+      {
+         using other = DefaultInitAllocator<U>;
+      };
+
+      DefaultInitAllocator() = default;
+
+      template<typename U>
+      DefaultInitAllocator(const DefaultInitAllocator<U>&) {}
+
+      template<typename U>
+      void construct(U* ptr)
+      {
+         ::new (static_cast<void*>(ptr)) U;
+      }
+
+      template<typename U, typename... Args>
+      void construct(U* ptr, Args&&... args)
+      {
+         ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+      }
+   };
+
+}
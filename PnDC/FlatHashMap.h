@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <utility>
+
+#include "MathUtil.h"
+
+//! \brief Open-addressing hash map with linear probing, meant as a thread-local aggregation table. Key and value types
+//!        have to be default constructible. Elements can only be inserted, never erased. The full (mixed) hash of each
+//!        key is stored with it, so callers can hash once and reuse the hash for partitioning and merging
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap
+{
+public:
+   explicit FlatHashMap(size_t initialCapacity = 16)
+   {
+      size_t capacity = 16;
+      while (capacity < initialCapacity) capacity <<= 1;
+      _slots.resize(capacity);
+   }
+
+   //! \brief Computes the hash of the given key as it is used by this map
+   static uint64_t HashOf(const Key& key)
+   {
+      return math::Mix64(static_cast<uint64_t>(Hash()(key)));
+   }
+
+   //! \brief Returns the value for the given key, inserts 'init' first if the key is not contained yet
+   //! \param key Key
+   //! \param hash Hash of the key, has to be computed with HashOf()
+   //! \param init Value to insert if the key is not present
+   Value& FindOrInsert(const Key& key, uint64_t hash, const Value& init)
+   {
+      if ((_size + 1) * 2 > _slots.size()) Grow();
+
+      auto idx = FindSlot(key, hash);
+      auto& slot = _slots[idx];
+      if (!slot._occupied)
+      {
+         slot._key = key;
+         slot._value = init;
+         slot._hash = hash;
+         slot._occupied = true;
+         _size++;
+      }
+      return slot._value;
+   }
+
+   Value& FindOrInsert(const Key& key, const Value& init)
+   {
+      return FindOrInsert(key, HashOf(key), init);
+   }
+
+   //! \brief Calls func(key, value, hash) for every element in the map
+   template<typename Func>
+   void ForEach(Func func) const
+   {
+      for (auto& slot : _slots)
+      {
+         if (slot._occupied) func(slot._key, slot._value, slot._hash);
+      }
+   }
+
+   size_t Size() const { return _size; }
+private:
+   struct Slot
+   {
+      Key _key;
+      Value _value;
+      uint64_t _hash = 0;
+      bool _occupied = false;
+   };
+
+   size_t FindSlot(const Key& key, uint64_t hash) const
+   {
+      auto mask = _slots.size() - 1;
+      auto idx = static_cast<size_t>(hash) & mask;
+      while (_slots[idx]._occupied && (_slots[idx]._hash != hash || !(_slots[idx]._key == key)))
+      {
+         idx = (idx + 1) & mask;
+      }
+      return idx;
+   }
+
+   void Grow()
+   {
+      std::vector<Slot> oldSlots(_slots.size() * 2);
+      std::swap(oldSlots, _slots);
+      for (auto& slot : oldSlots)
+      {
+         if (!slot._occupied) continue;
+         _slots[FindSlot(slot._key, slot._hash)] = std::move(slot);
+      }
+   }
+
+   std::vector<Slot> _slots;
+   size_t _size = 0;
+};
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+
 namespace math
 {
    
@@ -9,4 +12,20 @@ namespace math
       return !(val & 1);
    }
 
-}
\ No newline at end of file
+   //! \brief Bit mixing function of the SplitMix64 generator. Every bit of the input affects every bit of the output
+   inline uint64_t Mix64(uint64_t val)
+   {
+      val = (val ^ (val >> 30)) * 0xBF58476D1CE4E5B9ull;
+      val = (val ^ (val >> 27)) * 0x94D049BB133111EBull;
+      return val ^ (val >> 31);
+   }
+
+   //! \brief Returns the smallest power of two that is greater than or equal to val
+   inline size_t NextPowerOfTwo(size_t val)
+   {
+      size_t ret = 1;
+      while (ret < val) ret <<= 1;
+      return ret;
+   }
+
+}
@@ -4,17 +4,23 @@
 #include <future>
 #include <algorithm>
 #include <iterator>
+#include <stdexcept>
 
 #include "MathUtil.h"
 #include "TupleUtil.h"
 #include "TaskSystem.h"
 
+#ifndef _ASSERT
+#include <cassert>
+#define _ASSERT(expr) assert(expr)
+#endif
+
 namespace
 {
    template<typename T>
    void AwaitAllFutures(const std::vector<std::future<T>>& futures)
    {
-      for (auto& f : futures) f.wait();
+      for (auto& f : futures) task::Await(f);
    }
 
    template<typename T>
@@ -23,7 +29,7 @@ namespace
       using Result_t = decltype(futures[0].get());
       std::vector<Result_t> results;
       results.reserve(futures.size());
-      std::transform(futures.begin(), futures.end(), std::back_inserter(results), [](auto& f) { return f.get(); });
+      std::transform(futures.begin(), futures.end(), std::back_inserter(results), [](auto& f) { task::Await(f); return f.get(); });
       return results;
    }
 
@@ -153,7 +159,7 @@ auto ParallelDivideAndConquer(
    RootTask rootTask,
    const ExecParallelFlags flags = ExecParallelFlags::None)
 {
-   if (subtasks % 2 != 0) throw std::exception("Currently only an even number of subtasks is supported!");
+   if (subtasks % 2 != 0) throw std::runtime_error("Currently only an even number of subtasks is supported!");
 
    auto dataChunks = splitFunc(data, subtasks);
    using RootFuture_t = decltype(AsyncImpl<UseTaskSystem>::async(rootTask, *std::begin(dataChunks)));
@@ -0,0 +1,487 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+
+#include "ConcurrentQueue.h"
+#include "TaskSystem.h"
+#include "Sorting.h"
+
+//! \brief Streaming pipelines of stages that are connected by bounded channels. Stages never block a thread: a stage
+//!        schedules one task whenever an element is available and its output channel has room, up to the stage's
+//!        in-flight limit, and is re-armed whenever its input receives data or its output is drained. A full channel
+//!        stops the stage that writes into it, so fast stages are throttled to the speed of slower stages downstream
+//!        instead of buffering the whole data set
+namespace pipeline
+{
+
+   template<typename T> using Channel = BoundedConcurrentQueue<T>;
+   template<typename T> using ChannelPtr = std::shared_ptr<Channel<T>>;
+
+   //! \brief A pipeline of source, transform, aggregate and sink stages. Stages are added first, then Run() executes all
+   //!        of them concurrently until the source is exhausted and all data has reached the sinks. Stage functions run
+   //!        as regular tasks, so they may use parallel algorithms like TaskSystemParallelSort themselves. A pipeline
+   //!        can only be run once
+   class Pipeline
+   {
+   public:
+      Pipeline() = default;
+      Pipeline(const Pipeline&) = delete;
+      Pipeline& operator=(const Pipeline&) = delete;
+
+      //! \brief Adds a source stage. The producer is never called concurrently
+      //! \param producer Functor bool(T&) that produces the next element, returns false once there is no more data
+      //! \param capacity Capacity of the output channel
+      //! \returns Output channel of the stage
+      template<typename T, typename Producer>
+      ChannelPtr<T> AddSource(Producer producer, size_t capacity)
+      {
+         auto output = std::make_shared<Channel<T>>(capacity);
+         AddStage(std::make_unique<SourceStage<T>>(*this, output, std::function<bool(T&)>(std::move(producer))),
+            nullptr, output.get());
+         return output;
+      }
+
+      //! \brief Adds a stage that transforms each element of the input channel
+      //! \param input Input channel
+      //! \param func Functor that transforms a single element. Has to be thread-safe if parallelism is greater than one
+      //! \param parallelism Maximum number of tasks of this stage in flight. With more than one, the order of the
+      //!        elements is not kept
+      //! \param capacity Capacity of the output channel
+      //! \returns Output channel of the stage
+      template<typename In, typename Func>
+      auto AddTransform(ChannelPtr<In> input, Func func, size_t parallelism, size_t capacity)
+      {
+         using Out_t = std::decay_t<decltype(func(std::declval<In>()))>;
+         auto output = std::make_shared<Channel<Out_t>>(capacity);
+         AddStage(std::make_unique<Stage<In, Out_t>>(*this, input, output, parallelism, Emits::FromStep,
+            [func](In&& elem, Out_t& out) mutable
+            {
+               out = func(std::move(elem));
+               return true;
+            },
+            nullptr), input.get(), output.get());
+         return output;
+      }
+
+      //! \brief Adds a stage that groups consecutive elements of the input channel into chunks of the given size
+      //! \param input Input channel
+      //! \param chunkSize Number of elements per chunk, the last chunk may be smaller
+      //! \param capacity Capacity of the output channel, in chunks
+      //! \returns Output channel of the stage
+      template<typename T>
+      ChannelPtr<std::vector<T>> AddChunker(ChannelPtr<T> input, size_t chunkSize, size_t capacity)
+      {
+         auto output = std::make_shared<Channel<std::vector<T>>>(capacity);
+         //Only one task of this stage is in flight, so the chunk needs no lock
+         auto chunk = std::make_shared<std::vector<T>>();
+         AddStage(std::make_unique<Stage<T, std::vector<T>>>(*this, input, output, 1, Emits::FromStep,
+            [chunk, chunkSize](T&& elem, std::vector<T>& out)
+            {
+               chunk->push_back(std::move(elem));
+               if (chunk->size() < chunkSize) return false;
+               out = std::move(*chunk);
+               chunk->clear();
+               return true;
+            },
+            [chunk](std::vector<T>& out)
+            {
+               if (chunk->empty()) return false;
+               out = std::move(*chunk);
+               chunk->clear();
+               return true;
+            }), input.get(), output.get());
+         return output;
+      }
+
+      //! \brief Adds a stage that sorts each chunk of the input channel with TaskSystemParallelSort
+      //! \param input Input channel
+      //! \param parallelism Maximum number of chunks that are sorted at the same time
+      //! \param capacity Capacity of the output channel, in chunks
+      //! \returns Output channel of the stage
+      template<typename T>
+      ChannelPtr<std::vector<T>> AddChunkedSort(ChannelPtr<std::vector<T>> input, size_t parallelism, size_t capacity)
+      {
+         return AddTransform(input, [](std::vector<T> chunk)
+         {
+            TaskSystemParallelSort(chunk.begin(), chunk.end());
+            return chunk;
+         }, parallelism, capacity);
+      }
+
+      //! \brief Adds a stage that folds all elements of the input channel into a single result. Up to 'parallelism'
+      //!        elements are aggregated at the same time, each into its own copy of 'init'. Each of these partial results
+      //!        is then combined into the total under a lock, so 'combine' should be cheap compared to 'aggregate'
+      //! \param input Input channel
+      //! \param init Initial value of the partial results and of the total
+      //! \param aggregate Functor void(Acc&, In&&) that adds an element to a partial result. Has to be thread-safe
+      //!        if parallelism is greater than one
+      //! \param combine Functor void(Acc&, const Acc&) that adds a partial result to the total
+      //! \param parallelism Maximum number of elements that are aggregated at the same time
+      //! \returns Output channel that receives the total once the input is exhausted
+      template<typename In, typename Acc, typename Aggregate, typename Combine>
+      ChannelPtr<Acc> AddAggregate(ChannelPtr<In> input, Acc init, Aggregate aggregate, Combine combine, size_t parallelism)
+      {
+         struct Total
+         {
+            explicit Total(const Acc& init) :
+               _value(init) {}
+
+            Acc _value;
+            std::mutex _lock;
+         };
+
+         auto output = std::make_shared<Channel<Acc>>(1);
+         auto total = std::make_shared<Total>(init);
+         //Only the flush emits, so elements do not need room in the output channel
+         AddStage(std::make_unique<Stage<In, Acc>>(*this, input, output, parallelism, Emits::FromFlushOnly,
+            [total, init, aggregate, combine](In&& elem, Acc&) mutable
+            {
+               auto partial = init;
+               aggregate(partial, std::move(elem));
+               std::lock_guard<std::mutex> guard(total->_lock);
+               combine(total->_value, partial);
+               return false;
+            },
+            [total](Acc& out)
+            {
+               out = std::move(total->_value);
+               return true;
+            }), input.get(), output.get());
+         return output;
+      }
+
+      //! \brief Adds a stage that consumes all elements of the input channel
+      //! \param input Input channel
+      //! \param func Functor that consumes a single element. Has to be thread-safe if parallelism is greater than one
+      //! \param parallelism Maximum number of tasks of this stage in flight
+      template<typename In, typename Func>
+      void AddSink(ChannelPtr<In> input, Func func, size_t parallelism = 1)
+      {
+         AddStage(std::make_unique<Stage<In, NoOutput>>(*this, input, nullptr, parallelism, Emits::FromFlushOnly,
+            [func](In&& elem, NoOutput&) mutable
+            {
+               func(std::move(elem));
+               return false;
+            },
+            nullptr), input.get(), nullptr);
+      }
+
+      //! \brief Runs all stages and blocks until all of them are finished. Must not be called from within a task. If a
+      //!        stage throws, no new elements are started, the remaining stages wind down and the first exception is rethrown
+      void Run()
+      {
+         {
+            std::lock_guard<std::mutex> guard(_doneLock);
+            _remainingStages = _stages.size();
+         }
+         for (auto& stage : _stages) stage->Pump();
+
+         std::unique_lock<std::mutex> lock(_doneLock);
+         _done.wait(lock, [this]() { return _remainingStages == 0 && _activeTasks == 0; });
+         if (_error) std::rethrow_exception(_error);
+      }
+   private:
+      //! \brief Output type of sinks
+      struct NoOutput {};
+
+      //! \brief Whether the step of a stage can emit elements. Only steps that can emit reserve room in the output
+      //!        channel before they start, the flush always does
+      enum class Emits
+      {
+         FromStep,
+         FromFlushOnly
+      };
+
+      //! \brief Maximum number of elements that a task processes before it gives its slot back. Saves scheduling a task
+      //!        per element while data is flowing, without letting one stage hog a thread
+      static constexpr size_t MaxElementsPerTask = 64;
+
+      class StageBase
+      {
+      public:
+         explicit StageBase(Pipeline& pipeline) :
+            _pipeline(pipeline) {}
+         virtual ~StageBase() {}
+
+         //! \brief Schedules as many tasks as the stage's input, output and in-flight limit allow
+         virtual void Pump() = 0;
+
+         //! \brief Stages that read from or write into a channel of this stage
+         std::vector<StageBase*> _neighbours;
+      protected:
+         void PumpNeighbours()
+         {
+            for (auto neighbour : _neighbours) neighbour->Pump();
+         }
+
+         Pipeline& _pipeline;
+         std::mutex _lock;
+      };
+
+      template<typename Out>
+      class SourceStage : public StageBase
+      {
+      public:
+         SourceStage(Pipeline& pipeline, ChannelPtr<Out> output, std::function<bool(Out&)> producer) :
+            StageBase(pipeline),
+            _output(std::move(output)),
+            _producer(std::move(producer)) {}
+
+         void Pump() override
+         {
+            std::unique_lock<std::mutex> lock(_lock);
+            if (_finished || _running) return;
+            if (_exhausted || _pipeline.IsFailed())
+            {
+               _finished = true;
+               lock.unlock();
+               _output->Close();
+               _pipeline.OnStageFinished();
+               PumpNeighbours();
+               return;
+            }
+            if (!_output->TryReserve()) return;
+            _running = true;
+            lock.unlock();
+            _pipeline.Schedule([this]() { Produce(); });
+         }
+      private:
+         void Produce()
+         {
+            size_t produced = 0;
+            while (true)
+            {
+               Out elem;
+               bool hasElem = false;
+               try
+               {
+                  hasElem = _producer(elem);
+               }
+               catch (...)
+               {
+                  _pipeline.Fail(std::current_exception());
+               }
+               if (hasElem) _output->EnqueueReserved(std::move(elem));
+               else _output->CancelReservation();
+               PumpNeighbours();
+
+               std::lock_guard<std::mutex> guard(_lock);
+               if (!hasElem) _exhausted = true;
+               if (hasElem && ++produced < MaxElementsPerTask && !_pipeline.IsFailed() && _output->TryReserve()) continue;
+               _running = false;
+               break;
+            }
+            Pump();
+         }
+
+         ChannelPtr<Out> _output;
+         std::function<bool(Out&)> _producer;
+         bool _running = false;
+         bool _exhausted = false;
+         bool _finished = false;
+      };
+
+      template<typename In, typename Out>
+      class Stage : public StageBase
+      {
+      public:
+         //! \brief Processes one element, returns true if 'out' was filled
+         using Step_t = std::function<bool(In&&, Out&)>;
+         //! \brief Called once after the input is exhausted, returns true if 'out' was filled
+         using Flush_t = std::function<bool(Out&)>;
+
+         Stage(Pipeline& pipeline, ChannelPtr<In> input, ChannelPtr<Out> output, size_t maxInFlight, Emits emits, Step_t step, Flush_t flush) :
+            StageBase(pipeline),
+            _input(std::move(input)),
+            _output(std::move(output)),
+            _stepEmits(_output && emits == Emits::FromStep),
+            _maxInFlight(std::max(maxInFlight, size_t{ 1 })),
+            _step(std::move(step)),
+            _flush(std::move(flush)) {}
+
+         void Pump() override
+         {
+            while (true)
+            {
+               std::unique_lock<std::mutex> lock(_lock);
+               if (_finished || _flushing) return;
+
+               auto failed = _pipeline.IsFailed();
+               In elem;
+               if (!failed && _inFlight < _maxInFlight && TryTakeElement(elem))
+               {
+                  _inFlight++;
+                  lock.unlock();
+                  _pipeline.Schedule([this, elem = std::move(elem)]() mutable { Process(std::move(elem)); });
+                  continue;
+               }
+
+               if (_inFlight || !(failed || _input->IsDrained())) return;
+               if (!failed && _flush)
+               {
+                  //Pumped again once the next stage makes room
+                  if (!_output->TryReserve()) return;
+                  _flushing = true;
+                  lock.unlock();
+                  _pipeline.Schedule([this]() { Flush(); });
+                  return;
+               }
+               _finished = true;
+               lock.unlock();
+               Finish();
+               return;
+            }
+         }
+      private:
+         //! \brief Takes the next element of the input and reserves room for its result if the step can emit one.
+         //!        Expects the lock to be held
+         bool TryTakeElement(In& elem)
+         {
+            if (_stepEmits && !_output->TryReserve()) return false;
+            if (_input->TryDequeue(elem)) return true;
+            if (_stepEmits) _output->CancelReservation();
+            return false;
+         }
+
+         void Process(In elem)
+         {
+            size_t processed = 0;
+            while (true)
+            {
+               Out out;
+               bool hasOut = false;
+               try
+               {
+                  hasOut = _step(std::move(elem), out);
+               }
+               catch (...)
+               {
+                  _pipeline.Fail(std::current_exception());
+               }
+               _ASSERT(_stepEmits || !hasOut);
+               if (_stepEmits)
+               {
+                  if (hasOut) _output->EnqueueReserved(std::move(out));
+                  else _output->CancelReservation();
+               }
+               PumpNeighbours();
+
+               std::lock_guard<std::mutex> guard(_lock);
+               if (++processed < MaxElementsPerTask && !_pipeline.IsFailed() && TryTakeElement(elem)) continue;
+               _inFlight--;
+               break;
+            }
+            Pump();
+         }
+
+         void Flush()
+         {
+            Out out;
+            bool hasOut = false;
+            try
+            {
+               hasOut = _flush(out);
+            }
+            catch (...)
+            {
+               _pipeline.Fail(std::current_exception());
+            }
+            if (hasOut) _output->EnqueueReserved(std::move(out));
+            else _output->CancelReservation();
+
+            {
+               std::lock_guard<std::mutex> guard(_lock);
+               _finished = true;
+            }
+            Finish();
+         }
+
+         void Finish()
+         {
+            if (_output) _output->Close();
+            _pipeline.OnStageFinished();
+            PumpNeighbours();
+         }
+
+         ChannelPtr<In> _input;
+         ChannelPtr<Out> _output;
+         bool _stepEmits;
+         size_t _maxInFlight;
+         size_t _inFlight = 0;
+         Step_t _step;
+         Flush_t _flush;
+         bool _flushing = false;
+         bool _finished = false;
+      };
+
+      void AddStage(std::unique_ptr<StageBase> stage, const void* input, const void* output)
+      {
+         if (input)
+         {
+            auto producer = _producers.find(input);
+            if (producer == _producers.end()) throw std::invalid_argument("Channel does not belong to this pipeline!");
+            producer->second->_neighbours.push_back(stage.get());
+            stage->_neighbours.push_back(producer->second);
+         }
+         if (output) _producers[output] = stage.get();
+         _stages.push_back(std::move(stage));
+      }
+
+      //! \brief Runs the function as a task. Run() only returns once all of these tasks are done, so stages are never
+      //!        destroyed while one of their tasks still touches them
+      template<typename Func>
+      void Schedule(Func&& func)
+      {
+         {
+            std::lock_guard<std::mutex> guard(_doneLock);
+            _activeTasks++;
+         }
+         task::AddTask([this, func = std::forward<Func>(func)]() mutable
+         {
+            func();
+            std::lock_guard<std::mutex> guard(_doneLock);
+            if (--_activeTasks == 0 && _remainingStages == 0) _done.notify_all();
+         });
+      }
+
+      void OnStageFinished()
+      {
+         std::lock_guard<std::mutex> guard(_doneLock);
+         if (--_remainingStages == 0 && _activeTasks == 0) _done.notify_all();
+      }
+
+      void Fail(std::exception_ptr error)
+      {
+         std::lock_guard<std::mutex> guard(_doneLock);
+         if (!_error) _error = error;
+         _failed = true;
+      }
+
+      bool IsFailed() const
+      {
+         return _failed;
+      }
+
+      std::vector<std::unique_ptr<StageBase>> _stages;
+      //! \brief Stage that writes into a channel, by channel address
+      std::map<const void*, StageBase*> _producers;
+
+      size_t _remainingStages = 0;
+      size_t _activeTasks = 0;
+      std::atomic_bool _failed{ false };
+      std::exception_ptr _error;
+      std::mutex _doneLock;
+      std::condition_variable _done;
+   };
+
+}
@@ -0,0 +1,449 @@
+#include "ShardedSort.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "Sorting.h"
+#include "DataGeneration.h"
+
+namespace
+{
+   constexpr size_t SplitterOversampling = 64;
+   constexpr size_t MinPartitionChunkSize = 1 << 16;
+   //! \brief Time a freshly started worker process has to answer the handshake
+   constexpr int HandshakeTimeoutMs = 10'000;
+   constexpr uint64_t HandshakeMagic = 0x50'4E'44'43'53'48'52'44ull;
+
+   //! \brief First message of a worker, tells the coordinator that the worker runs RunWorker()
+   struct WorkerHello
+   {
+      uint64_t _magic;
+   };
+
+   //! \brief Message from the coordinator to a worker, describing the shard that the worker has to sort
+   struct ShardRequest
+   {
+      char _shmName[64];
+      uint64_t _totalCount;
+      uint64_t _offset;
+      uint64_t _count;
+      uint64_t _numThreads;
+      uint64_t _firstCore;
+   };
+
+   //! \brief Message from a worker to the coordinator after the shard was sorted
+   struct ShardResponse
+   {
+      uint64_t _status;
+   };
+
+   std::runtime_error SystemError(const std::string& what)
+   {
+      return std::runtime_error(what + ": " + std::strerror(errno));
+   }
+
+   bool SendAll(int socket, const void* data, size_t size)
+   {
+      auto bytes = static_cast<const char*>(data);
+      while (size)
+      {
+         auto sent = send(socket, bytes, size, MSG_NOSIGNAL);
+         if (sent < 0 && errno == EINTR) continue;
+         if (sent <= 0) return false;
+         bytes += sent;
+         size -= static_cast<size_t>(sent);
+      }
+      return true;
+   }
+
+   bool ReceiveAll(int socket, void* data, size_t size)
+   {
+      auto bytes = static_cast<char*>(data);
+      while (size)
+      {
+         auto received = recv(socket, bytes, size, 0);
+         if (received < 0 && errno == EINTR) continue;
+         if (received <= 0) return false;
+         bytes += received;
+         size -= static_cast<size_t>(received);
+      }
+      return true;
+   }
+
+   //! \brief POSIX shared memory segment, mapped into the address space of this process. The creating process
+   //!        owns the segment and unlinks it on destruction
+   class SharedMemory
+   {
+   public:
+      SharedMemory(const std::string& name, size_t size, bool create) :
+         _name(name),
+         _size(size),
+         _owner(create)
+      {
+         auto fd = shm_open(name.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, S_IRUSR | S_IWUSR);
+         if (fd < 0) throw SystemError("shm_open failed for " + name);
+         if (create && ftruncate(fd, static_cast<off_t>(size)) != 0)
+         {
+            auto error = SystemError("ftruncate failed for " + name);
+            close(fd);
+            shm_unlink(name.c_str());
+            throw error;
+         }
+         _data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         close(fd);
+         if (_data == MAP_FAILED)
+         {
+            auto error = SystemError("mmap failed for " + name);
+            if (create) shm_unlink(name.c_str());
+            throw error;
+         }
+      }
+
+      ~SharedMemory()
+      {
+         munmap(_data, _size);
+         if (_owner) shm_unlink(_name.c_str());
+      }
+
+      SharedMemory(const SharedMemory&) = delete;
+      SharedMemory& operator=(const SharedMemory&) = delete;
+
+      void* Data() const { return _data; }
+   private:
+      std::string _name;
+      size_t _size;
+      bool _owner;
+      void* _data = nullptr;
+   };
+
+   //! \brief A worker process, started from the current executable. Communicates with the coordinator over a
+   //!        Unix domain socket
+   class WorkerProcess
+   {
+   public:
+      WorkerProcess()
+      {
+         int sockets[2];
+         if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) throw SystemError("socketpair failed");
+
+         //Prepare everything before forking, only async-signal-safe calls are allowed in the child until exec
+         auto socketArg = std::to_string(sockets[1]);
+         const char* exePath = "/proc/self/exe";
+         char* args[] = { const_cast<char*>(exePath), const_cast<char*>(shard::WorkerArgument), &socketArg[0], nullptr };
+         auto marker = std::string(shard::WorkerEnvironmentVariable) + "=1";
+         std::vector<char*> environment;
+         for (auto variable = environ; *variable; ++variable) environment.push_back(*variable);
+         environment.push_back(&marker[0]);
+         environment.push_back(nullptr);
+
+         _pid = fork();
+         if (_pid < 0)
+         {
+            auto error = SystemError("fork failed");
+            close(sockets[0]);
+            close(sockets[1]);
+            throw error;
+         }
+         if (_pid == 0)
+         {
+            //Only the worker's end of the socket may survive the exec
+            fcntl(sockets[1], F_SETFD, 0);
+            execve(exePath, args, environment.data());
+            _exit(127);
+         }
+
+         close(sockets[1]);
+         _socket = sockets[0];
+      }
+
+      ~WorkerProcess()
+      {
+         Wait();
+      }
+
+      WorkerProcess(const WorkerProcess&) = delete;
+      WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+      int Socket() const { return _socket; }
+
+      //! \brief Waits for the first message of the worker
+      //! \returns False if the worker exited, timed out or is not running RunWorker()
+      bool Handshake()
+      {
+         pollfd pollFd{ _socket, POLLIN, 0 };
+         int ready;
+         while ((ready = poll(&pollFd, 1, HandshakeTimeoutMs)) < 0 && errno == EINTR) {}
+         if (ready <= 0) return false;
+         WorkerHello hello;
+         return ReceiveAll(_socket, &hello, sizeof(hello)) && hello._magic == HandshakeMagic;
+      }
+
+      //! \brief Terminates a worker that does not behave, Wait() then returns immediately
+      void Kill()
+      {
+         if (_pid > 0) kill(_pid, SIGKILL);
+      }
+
+      //! \brief Closes the connection and waits for the worker to exit
+      //! \returns True if the worker exited successfully
+      bool Wait()
+      {
+         if (_socket >= 0)
+         {
+            close(_socket);
+            _socket = -1;
+         }
+         if (_pid <= 0) return _exitedCleanly;
+
+         int status = 0;
+         while (waitpid(_pid, &status, 0) < 0 && errno == EINTR) {}
+         _pid = -1;
+         _exitedCleanly = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+         return _exitedCleanly;
+      }
+   private:
+      pid_t _pid = -1;
+      int _socket = -1;
+      bool _exitedCleanly = false;
+   };
+
+   std::string MakeSharedMemoryName()
+   {
+      static std::atomic<size_t> s_counter{ 0 };
+      return "/pndc-shard-" + std::to_string(getpid()) + "-" + std::to_string(s_counter++);
+   }
+
+   //! \brief Picks numShards - 1 splitters from a random sample of the data
+   std::vector<size_t> SampleSplitters(const std::vector<size_t>& data, size_t numShards)
+   {
+      auto sampleSize = numShards * SplitterOversampling;
+      std::vector<size_t> sample;
+      sample.reserve(sampleSize);
+      for (size_t idx = 0; idx < sampleSize; idx++)
+      {
+         data::CounterRng rng(data.size(), idx);
+         sample.push_back(data[rng.NextInRange(data.size() - 1)]);
+      }
+      std::sort(sample.begin(), sample.end());
+
+      std::vector<size_t> splitters;
+      splitters.reserve(numShards - 1);
+      for (size_t shard = 1; shard < numShards; shard++)
+      {
+         splitters.push_back(sample[shard * SplitterOversampling]);
+      }
+      return splitters;
+   }
+
+   //! \brief Scatters the data into 'target' so that shard 'i' contains all values in [splitters[i - 1], splitters[i]).
+   //!        A value that equals splitters may go to any shard from the first one of those splitters up to the one
+   //!        after the last, without breaking the global order. Such values are spread over these shards by their
+   //!        index, so heavily duplicated values do not end up in a single shard. Counting and scattering both run in
+   //!        parallel on the task system
+   //! \returns Offsets of the shards in 'target'
+   std::vector<size_t> PartitionIntoShards(const std::vector<size_t>& data, const std::vector<size_t>& splitters, size_t* target)
+   {
+      auto numShards = splitters.size() + 1;
+      auto numChunks = std::max(size_t{ 1 }, std::min(task::GetMaxConcurrency(), data.size() / MinPartitionChunkSize));
+      auto chunkSize = data.size() / numChunks;
+      auto chunkBegin = [&](size_t chunk) { return chunk * chunkSize; };
+      auto chunkEnd = [&](size_t chunk) { return (chunk == numChunks - 1) ? data.size() : (chunk + 1) * chunkSize; };
+      auto shardOf = [&](size_t idx)
+      {
+         auto val = data[idx];
+         auto upper = std::upper_bound(splitters.begin(), splitters.end(), val);
+         auto shard = static_cast<size_t>(upper - splitters.begin());
+         if (!shard || splitters[shard - 1] != val) return shard;
+         auto first = static_cast<size_t>(std::lower_bound(splitters.begin(), upper, val) - splitters.begin());
+         return first + idx % (shard - first + 1);
+      };
+
+      std::vector<std::vector<size_t>> positions(numChunks, std::vector<size_t>(numShards, 0));
+      std::vector<std::future<void>> futures;
+      futures.reserve(numChunks);
+      for (size_t chunk = 0; chunk < numChunks; chunk++)
+      {
+         futures.push_back(task::AddAwaitableTask([&, chunk]()
+         {
+            auto& counts = positions[chunk];
+            for (auto idx = chunkBegin(chunk); idx < chunkEnd(chunk); idx++) counts[shardOf(idx)]++;
+         }));
+      }
+      AwaitAllFutures(futures);
+
+      //Turn the counts into write positions. Within a shard, the chunks are written in order
+      std::vector<size_t> offsets(numShards + 1, 0);
+      size_t position = 0;
+      for (size_t shard = 0; shard < numShards; shard++)
+      {
+         offsets[shard] = position;
+         for (auto& chunkPositions : positions)
+         {
+            auto count = chunkPositions[shard];
+            chunkPositions[shard] = position;
+            position += count;
+         }
+      }
+      offsets[numShards] = position;
+
+      futures.clear();
+      for (size_t chunk = 0; chunk < numChunks; chunk++)
+      {
+         futures.push_back(task::AddAwaitableTask([&, chunk]()
+         {
+            auto& writePositions = positions[chunk];
+            for (auto idx = chunkBegin(chunk); idx < chunkEnd(chunk); idx++) target[writePositions[shardOf(idx)]++] = data[idx];
+         }));
+      }
+      AwaitAllFutures(futures);
+      return offsets;
+   }
+}
+
+namespace shard
+{
+
+   bool IsWorkerProcess(int argc, char** argv)
+   {
+      return argc >= 3 && std::strcmp(argv[1], WorkerArgument) == 0 && std::getenv(WorkerEnvironmentVariable);
+   }
+
+   int RunWorker(int argc, char** argv)
+   {
+      if (!IsWorkerProcess(argc, argv)) return 1;
+      auto socket = std::atoi(argv[2]);
+
+      WorkerHello hello{ HandshakeMagic };
+      if (!SendAll(socket, &hello, sizeof(hello)))
+      {
+         close(socket);
+         return 1;
+      }
+
+      ShardRequest request;
+      if (!ReceiveAll(socket, &request, sizeof(request)))
+      {
+         close(socket);
+         return 1;
+      }
+      request._shmName[sizeof(request._shmName) - 1] = '\0';
+
+      ShardResponse response{ 0 };
+      task::Initialize(static_cast<size_t>(request._numThreads), static_cast<size_t>(request._firstCore));
+      try
+      {
+         SharedMemory sharedMemory(request._shmName, static_cast<size_t>(request._totalCount) * sizeof(size_t), false);
+         auto begin = static_cast<size_t*>(sharedMemory.Data()) + request._offset;
+         TaskSystemParallelSort(begin, begin + request._count);
+      }
+      catch (const std::exception&)
+      {
+         response._status = 1;
+      }
+      task::Shutdown();
+
+      auto sent = SendAll(socket, &response, sizeof(response));
+      close(socket);
+      return (sent && !response._status) ? 0 : 1;
+   }
+
+   std::vector<size_t> ShardedSort(std::vector<size_t>& data, size_t numWorkers)
+   {
+      if (std::getenv(WorkerEnvironmentVariable))
+         throw std::logic_error("Sharded sort called from a worker process, main() has to forward to shard::RunWorker()!");
+      if (!numWorkers) throw std::invalid_argument("Sharded sort requires at least one worker!");
+      if (data.empty()) return std::vector<size_t>(numWorkers + 1, 0);
+
+      auto name = MakeSharedMemoryName();
+      SharedMemory sharedMemory(name, data.size() * sizeof(size_t), true);
+      auto shardData = static_cast<size_t*>(sharedMemory.Data());
+      auto offsets = PartitionIntoShards(data, SampleSplitters(data, numWorkers), shardData);
+
+      //Split the cores of this machine evenly between the workers
+      auto numCores = std::max(std::thread::hardware_concurrency(), 1u);
+      auto threadsPerWorker = std::max(numCores / numWorkers, size_t{ 1 });
+
+      std::vector<std::unique_ptr<WorkerProcess>> workers;
+      workers.reserve(numWorkers);
+      for (size_t worker = 0; worker < numWorkers; worker++) workers.push_back(std::make_unique<WorkerProcess>());
+      for (auto& worker : workers)
+      {
+         if (worker->Handshake()) continue;
+         //Workers that run the host's main() instead of RunWorker() may never exit on their own
+         for (auto& other : workers) other->Kill();
+         throw std::runtime_error("Worker process did not answer the handshake, main() has to forward to shard::RunWorker()!");
+      }
+
+      for (size_t worker = 0; worker < numWorkers; worker++)
+      {
+         ShardRequest request;
+         std::memset(&request, 0, sizeof(request));
+         std::strncpy(request._shmName, name.c_str(), sizeof(request._shmName) - 1);
+         request._totalCount = data.size();
+         request._offset = offsets[worker];
+         request._count = offsets[worker + 1] - offsets[worker];
+         request._numThreads = threadsPerWorker;
+         request._firstCore = (worker * threadsPerWorker) % numCores;
+         if (!SendAll(workers[worker]->Socket(), &request, sizeof(request)))
+         {
+            throw std::runtime_error("Failed to send shard to worker process!");
+         }
+      }
+
+      for (auto& worker : workers)
+      {
+         ShardResponse response;
+         if (!ReceiveAll(worker->Socket(), &response, sizeof(response)) || response._status != 0 || !worker->Wait())
+         {
+            throw std::runtime_error("Worker process failed to sort its shard!");
+         }
+      }
+
+      ParallelForBlocks(data.size(), [&](size_t from, size_t to)
+      {
+         std::copy(shardData + from, shardData + to, data.begin() + from);
+      });
+      return offsets;
+   }
+
+}
+
+#else
+
+namespace shard
+{
+
+   bool IsWorkerProcess(int argc, char** argv)
+   {
+      return argc >= 3 && std::strcmp(argv[1], WorkerArgument) == 0 && std::getenv(WorkerEnvironmentVariable);
+   }
+
+   int RunWorker(int, char**)
+   {
+      return 1;
+   }
+
+   std::vector<size_t> ShardedSort(std::vector<size_t>&, size_t)
+   {
+      throw std::runtime_error("Sharded sort is only supported on Linux!");
+   }
+
+}
+
+#endif
\ No newline at end of file
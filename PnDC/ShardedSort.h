@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//! \brief Sorting across multiple worker processes. A coordinator samples splitters, range-partitions the input into
+//!        one shard per worker and places the shards in POSIX shared memory. Each worker process sorts its shard with
+//!        TaskSystemParallelSort, control messages are exchanged over Unix domain sockets. Worker processes are started
+//!        from the same executable, which has to forward to RunWorker() (see IsWorkerProcess()). Workers are marked by an
+//!        environment variable and have to answer a handshake, so an executable that does not forward fails instead of
+//!        spawning workers recursively. Only supported on Linux
+namespace shard
+{
+
+   //! \brief Command line argument that marks a process as a sharded sort worker
+   constexpr const char* WorkerArgument = "--sharded-sort-worker";
+
+   //! \brief Environment variable that is set for worker processes
+   constexpr const char* WorkerEnvironmentVariable = "PNDC_SHARDED_SORT_WORKER";
+
+   //! \brief Returns true if the current process was started as a sharded sort worker
+   bool IsWorkerProcess(int argc, char** argv);
+
+   //! \brief Entry point of a sharded sort worker process
+   //! \returns Exit code for the worker process
+   int RunWorker(int argc, char** argv);
+
+   //! \brief Sorts the given data with 'numWorkers' worker processes. After sorting, the data is globally sorted and shard
+   //!        'i' occupies the range [offsets[i], offsets[i + 1])
+   //! \param data Data to sort
+   //! \param numWorkers Number of worker processes
+   //! \returns Offsets of the shards, numWorkers + 1 entries
+   //! \throws std::logic_error if called from within a worker process, i.e. main() does not forward to RunWorker()
+   //! \throws std::runtime_error if a worker process does not answer the handshake or fails to sort its shard
+   std::vector<size_t> ShardedSort(std::vector<size_t>& data, size_t numWorkers);
+
+}
\ No newline at end of file
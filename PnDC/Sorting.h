@@ -5,8 +5,11 @@
 #include <thread>
 #include <condition_variable>
 #include <vector>
+#include <iterator>
 
 #include "ParallelUtil.h"
+#include "ArenaAllocator.h"
+#include "DefaultInitAllocator.h"
 
 template<typename Iter>
 void SequentialSort(Iter iBegin, Iter iEnd)
@@ -39,7 +42,7 @@ template<size_t Cores, typename Iter>
 void ParallelSort(Iter begin, Iter end)
 {
    static_assert(Cores > 1, "Parallel sort requires more than one core!");
-   if (Cores > std::thread::hardware_concurrency()) throw std::exception("Machine has insufficient cores!");
+   if (Cores > std::thread::hardware_concurrency()) throw std::runtime_error("Machine has insufficient cores!");
    
    auto res = ParallelDivideAndConquer(
       std::make_pair(begin, end),
@@ -78,9 +81,10 @@ void NaiveParallelSort(Iter begin, Iter end)
 template<typename Iter>
 void TaskSystemParallelSort(Iter begin, Iter end)
 {
+   //The pair-wise merge needs an even number of chunks on every level
    auto res = ParallelDivideAndConquer<true>(
       std::make_pair(begin, end),
-      task::GetMaxConcurrency(),
+      math::NextPowerOfTwo(std::max(task::GetMaxConcurrency(), size_t{ 2 })),
       [](auto pair, size_t chunks) { return SplitRange(pair.first, pair.second, chunks); },
       [](auto l, auto r)
       {
@@ -91,4 +95,317 @@ void TaskSystemParallelSort(Iter begin, Iter end)
       [](auto pair) { std::sort(pair.first, pair.second); return pair; },
       ExecParallelFlags::MergeIsTrivial
       );
-}
\ No newline at end of file
+}
+
+namespace
+{
+
+   //! \brief Merges the sorted ranges [begin, mid) and [mid, end). Only the left range is moved to 'scratch', so it 
+   //!        has to have room for mid - begin elements
+   template<typename Iter, typename T>
+   void MergeWithBuffer(Iter begin, Iter mid, Iter end, T* scratch)
+   {
+      auto scratchEnd = std::copy(begin, mid, scratch);
+      auto left = scratch;
+      auto right = mid;
+      auto out = begin;
+      while (left != scratchEnd && right != end)
+      {
+         if (*right < *left) *out++ = *right++;
+         else *out++ = *left++;
+      }
+      std::copy(left, scratchEnd, out);
+   }
+
+}
+
+//! \brief Parallel merge sort using the hand-written task system. The merge temporaries are allocated from the given
+//!        arena instead of the default heap
+template<typename Iter>
+void TaskSystemParallelSort(Iter begin, Iter end, mem::Arena& arena)
+{
+   using Value_t = typename std::iterator_traits<Iter>::value_type;
+   static_assert(std::is_trivially_copyable<Value_t>::value, "Sorting with an arena requires trivially copyable elements!");
+
+   auto count = static_cast<size_t>(std::distance(begin, end));
+   mem::ArenaAllocator<Value_t> allocator(arena);
+   auto scratch = allocator.allocate(count);
+
+   //Every merge uses the part of the scratch buffer that lines up with its range, so concurrent merges never overlap
+   ParallelDivideAndConquer<true>(
+      std::make_pair(begin, end),
+      math::NextPowerOfTwo(std::max(task::GetMaxConcurrency(), size_t{ 2 })),
+      [](auto pair, size_t chunks) { return SplitRange(pair.first, pair.second, chunks); },
+      [=](auto l, auto r)
+      {
+         _ASSERT(l.second == r.first);
+         MergeWithBuffer(l.first, l.second, r.second, scratch + std::distance(begin, l.first));
+         return std::make_pair(l.first, r.second);
+      },
+      [](auto pair) { std::sort(pair.first, pair.second); return pair; },
+      ExecParallelFlags::MergeIsTrivial
+      );
+
+   allocator.deallocate(scratch, count);
+}
+
+namespace
+{
+
+   //! \brief Sorts a batch of independent segments with the task system. Segments that are small compared to the
+   //!        whole batch are packed together and sorted whole by a single task. Only oversized segments are split
+   //!        into runs which are sorted and merged in parallel. All tasks of a phase are scheduled together, so the
+   //!        task system stays saturated instead of forking and joining once per segment
+   template<typename Iter>
+   void BatchSortImpl(const std::vector<std::pair<Iter, Iter>>& segments)
+   {
+      static constexpr size_t MinGrainSize = 1 << 14;
+      using Range_t = std::pair<Iter, Iter>;
+
+      size_t totalSize = 0;
+      for (auto& segment : segments) totalSize += static_cast<size_t>(std::distance(segment.first, segment.second));
+      if (!totalSize) return;
+
+      //Aim for a few tasks per thread so that uneven segment sizes still balance out
+      const auto grainSize = std::max(MinGrainSize, totalSize / (task::GetMaxConcurrency() * 4));
+
+      std::vector<std::vector<Range_t>> smallBatches;
+      std::vector<std::vector<Range_t>> largeSegmentRuns;
+      std::vector<Range_t> currentBatch;
+      size_t currentBatchSize = 0;
+      for (auto& segment : segments)
+      {
+         auto size = static_cast<size_t>(std::distance(segment.first, segment.second));
+         if (size < 2) continue;
+         if (size > grainSize)
+         {
+            largeSegmentRuns.push_back(SplitRange(segment.first, segment.second, (size + grainSize - 1) / grainSize));
+            continue;
+         }
+
+         currentBatch.push_back(segment);
+         currentBatchSize += size;
+         if (currentBatchSize >= grainSize)
+         {
+            smallBatches.push_back(std::move(currentBatch));
+            currentBatch.clear();
+            currentBatchSize = 0;
+         }
+      }
+      if (!currentBatch.empty()) smallBatches.push_back(std::move(currentBatch));
+
+      //Sort the small batches together with the runs of all oversized segments
+      std::vector<std::future<void>> futures;
+      for (auto& batch : smallBatches)
+      {
+         futures.push_back(task::AddAwaitableTask([&batch]()
+         {
+            for (auto& range : batch) std::sort(range.first, range.second);
+         }));
+      }
+      for (auto& runs : largeSegmentRuns)
+      {
+         for (auto& run : runs)
+         {
+            futures.push_back(task::AddAwaitableTask([run]() { std::sort(run.first, run.second); }));
+         }
+      }
+      AwaitAllFutures(futures);
+
+      //Pair-wise merge of the runs. The merges of one level are scheduled together for all oversized segments
+      while (true)
+      {
+         futures.clear();
+         for (auto& runs : largeSegmentRuns)
+         {
+            if (runs.size() < 2) continue;
+            std::vector<Range_t> mergedRuns;
+            mergedRuns.reserve((runs.size() + 1) / 2);
+            for (size_t idx = 0; idx + 1 < runs.size(); idx += 2)
+            {
+               auto l = runs[idx];
+               auto r = runs[idx + 1];
+               _ASSERT(l.second == r.first);
+               futures.push_back(task::AddAwaitableTask([l, r]() { std::inplace_merge(l.first, l.second, r.second); }));
+               mergedRuns.push_back(std::make_pair(l.first, r.second));
+            }
+            if (!math::IsEven(runs.size())) mergedRuns.push_back(runs.back());
+            runs = std::move(mergedRuns);
+         }
+         if (futures.empty()) break;
+         AwaitAllFutures(futures);
+      }
+   }
+
+}
+
+//! \brief Sorts each range in a batch of independent ranges (e.g. a std::vector<std::vector<T>>) using the task system
+//! \param ranges Range of ranges that shall be sorted
+template<typename RangeOfRanges>
+void BatchSort(RangeOfRanges& ranges)
+{
+   using Iter_t = decltype(std::begin(*std::begin(ranges)));
+   std::vector<std::pair<Iter_t, Iter_t>> segments;
+   for (auto&& range : ranges)
+   {
+      segments.push_back(std::make_pair(std::begin(range), std::end(range)));
+   }
+   BatchSortImpl(segments);
+}
+
+//! \brief Segmented sort using the task system. Sorts each segment [begin + offsets[i], begin + offsets[i + 1]) 
+//!        independently of the others
+//! \param begin Start of the data
+//! \param offsetsBegin Start of the segment offsets. The offsets are ascending and include both the start of 
+//!                     the first and the end of the last segment
+//! \param offsetsEnd End of the segment offsets
+template<typename Iter, typename OffsetIter>
+void SegmentedSort(Iter begin, OffsetIter offsetsBegin, OffsetIter offsetsEnd)
+{
+   std::vector<std::pair<Iter, Iter>> segments;
+   if (offsetsBegin == offsetsEnd) return;
+   for (auto offset = std::next(offsetsBegin); offset != offsetsEnd; ++offset)
+   {
+      _ASSERT(*std::prev(offset) <= *offset);
+      segments.push_back(std::make_pair(begin + *std::prev(offset), begin + *offset));
+   }
+   BatchSortImpl(segments);
+}
+
+
+namespace
+{
+
+   //! \brief Number of elements that a single task gathers in one go during ApplyPermutation
+   constexpr size_t GatherBlockSize = 4096;
+
+   //! \brief Calls func(from, to) for all blocks of GatherBlockSize elements in [0, count). The blocks are spread
+   //!        over the task system, each task handles a contiguous range of blocks
+   template<typename Func>
+   void ParallelForBlocks(size_t count, Func func)
+   {
+      auto numBlocks = (count + GatherBlockSize - 1) / GatherBlockSize;
+      auto numTasks = std::min(numBlocks, task::GetMaxConcurrency());
+      std::vector<std::future<void>> futures;
+      futures.reserve(numTasks);
+      for (size_t taskIdx = 0; taskIdx < numTasks; taskIdx++)
+      {
+         auto firstBlock = (taskIdx * numBlocks) / numTasks;
+         auto lastBlock = ((taskIdx + 1) * numBlocks) / numTasks;
+         futures.push_back(task::AddAwaitableTask([=, &func]()
+         {
+            for (auto block = firstBlock; block < lastBlock; block++)
+            {
+               func(block * GatherBlockSize, std::min((block + 1) * GatherBlockSize, count));
+            }
+         }));
+      }
+      AwaitAllFutures(futures);
+   }
+
+   //! \brief Key of an element together with its index. Trivial for trivial keys, so buffers of these are not zero-filled
+   template<typename Key>
+   struct KeyIndex
+   {
+      Key _key;
+      size_t _index;
+   };
+
+   //! \brief Orders by key and equal keys by index, which makes the unstable parallel sort stable
+   template<typename Key>
+   bool operator<(const KeyIndex<Key>& l, const KeyIndex<Key>& r)
+   {
+      if (l._key < r._key) return true;
+      if (r._key < l._key) return false;
+      return l._index < r._index;
+   }
+
+   template<typename Key> using KeyOrder = std::vector<KeyIndex<Key>, mem::DefaultInitAllocator<KeyIndex<Key>>>;
+
+   //! \brief Extracts the keys of all elements together with their index into a compact buffer and sorts it with
+   //!        the task system
+   template<typename Key, typename RndIter, typename KeyFunc>
+   KeyOrder<Key> SortedKeyOrder(RndIter begin, size_t count, KeyFunc keyFunc)
+   {
+      KeyOrder<Key> order(count);
+      ParallelForBlocks(count, [&](size_t from, size_t to)
+      {
+         for (auto idx = from; idx < to; idx++) order[idx] = KeyIndex<Key>{ keyFunc(*(begin + idx)), idx };
+      });
+      TaskSystemParallelSort(order.begin(), order.end());
+      return order;
+   }
+
+   //! \brief Moves element order[i]._index of the input to position 'i' of the output, block by block in parallel
+   template<typename RndIter, typename OutIter, typename Key>
+   void GatherByOrder(RndIter begin, const KeyOrder<Key>& order, OutIter out)
+   {
+      ParallelForBlocks(order.size(), [&](size_t from, size_t to)
+      {
+         for (auto idx = from; idx < to; idx++) *(out + idx) = std::move(*(begin + order[idx]._index));
+      });
+   }
+
+   //! \brief Reorders a range so that element 'i' is the element that was at order[i]._index before. Gathers into a
+   //!        temporary buffer that is not zero-filled, then moves the buffer back
+   template<typename RndIter, typename Key>
+   void ApplyPermutation(RndIter begin, const KeyOrder<Key>& order)
+   {
+      using Value_t = typename std::iterator_traits<RndIter>::value_type;
+      std::vector<Value_t, mem::DefaultInitAllocator<Value_t>> gathered(order.size());
+      GatherByOrder(begin, order, gathered.begin());
+      ParallelForBlocks(order.size(), [&](size_t from, size_t to)
+      {
+         std::move(gathered.begin() + from, gathered.begin() + to, begin + from);
+      });
+   }
+
+}
+
+//! \brief Stable parallel sort of large records by a small key. Only the keys and the record indices are sorted, the
+//!        records themselves are moved exactly twice in a parallel gather, instead of in every sort and merge pass
+//! \param begin Start of the records
+//! \param end End of the records
+//! \param keyFunc Functor that returns the key of a record
+template<typename RndIter, typename KeyFunc>
+void ParallelSortByKey(RndIter begin, RndIter end, KeyFunc keyFunc)
+{
+   using Key_t = std::decay_t<decltype(keyFunc(*begin))>;
+   auto order = SortedKeyOrder<Key_t>(begin, static_cast<size_t>(std::distance(begin, end)), keyFunc);
+   ApplyPermutation(begin, order);
+}
+
+//! \brief Stable parallel sort of large records by a small key into a separate output range. The records are moved
+//!        exactly once, by a parallel gather straight into the output
+//! \param begin Start of the records
+//! \param end End of the records
+//! \param out Start of the output, has room for all records and does not overlap the input
+//! \param keyFunc Functor that returns the key of a record
+template<typename RndIter, typename OutIter, typename KeyFunc>
+void ParallelSortByKey(RndIter begin, RndIter end, OutIter out, KeyFunc keyFunc)
+{
+   using Key_t = std::decay_t<decltype(keyFunc(*begin))>;
+   auto order = SortedKeyOrder<Key_t>(begin, static_cast<size_t>(std::distance(begin, end)), keyFunc);
+   GatherByOrder(begin, order, out);
+}
+
+//! \brief Stable parallel sort of several parallel arrays (e.g. the columns of a table) by one key column. The key column
+//!        is sorted and all other columns are permuted the same way
+//! \param keyBegin Start of the key column
+//! \param keyEnd End of the key column
+//! \param columns Iterators to the start of the other columns, which have at least as many elements as the key column
+template<typename KeyIter, typename... ColumnIters>
+void ParallelSortColumnsByKey(KeyIter keyBegin, KeyIter keyEnd, ColumnIters... columns)
+{
+   using Key_t = typename std::iterator_traits<KeyIter>::value_type;
+   auto count = static_cast<size_t>(std::distance(keyBegin, keyEnd));
+   auto order = SortedKeyOrder<Key_t>(keyBegin, count, [](const Key_t& key) { return key; });
+
+   //The sorted keys are already in the order buffer, no need to gather them
+   ParallelForBlocks(count, [&](size_t from, size_t to)
+   {
+      for (auto idx = from; idx < to; idx++) *(keyBegin + idx) = order[idx]._key;
+   });
+   int dummy[] = { 0, (ApplyPermutation(columns, order), 0)... };
+   (void)dummy;
+}
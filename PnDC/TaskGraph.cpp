@@ -0,0 +1,110 @@
+#include "TaskGraph.h"
+
+#include <stdexcept>
+
+namespace task
+{
+
+   Graph::NodeId Graph::AddNodeImpl(std::function<void()> func, Priority priority)
+   {
+      auto id = _nodes.size();
+      _nodes.push_back(std::make_unique<Node>(*this, id, std::move(func), priority));
+      _validated = false;
+      return id;
+   }
+
+   void Graph::AddDependency(NodeId before, NodeId after)
+   {
+      if (before >= _nodes.size() || after >= _nodes.size()) throw std::out_of_range("Invalid node id!");
+      _nodes[before]->_successors.push_back(after);
+      _nodes[after]->_numPredecessors++;
+      _validated = false;
+   }
+
+   void Graph::Validate()
+   {
+      //Kahn's algorithm, every node has to be reachable from the nodes without predecessors
+      std::vector<size_t> pending(_nodes.size());
+      std::vector<NodeId> ready;
+      _roots.clear();
+      for (NodeId id = 0; id < _nodes.size(); id++)
+      {
+         pending[id] = _nodes[id]->_numPredecessors;
+         if (!pending[id])
+         {
+            ready.push_back(id);
+            _roots.push_back(_nodes[id].get());
+         }
+      }
+
+      size_t visited = 0;
+      while (!ready.empty())
+      {
+         auto id = ready.back();
+         ready.pop_back();
+         visited++;
+         for (auto successor : _nodes[id]->_successors)
+         {
+            if (--pending[successor] == 0) ready.push_back(successor);
+         }
+      }
+      if (visited != _nodes.size()) throw std::logic_error("Task graph contains a cycle!");
+      _validated = true;
+   }
+
+   void Graph::Run()
+   {
+      if (_nodes.empty()) return;
+      if (!_validated) Validate();
+
+      for (auto& node : _nodes) node->_pendingPredecessors = node->_numPredecessors;
+      _remainingNodes = _nodes.size();
+      _failed = false;
+      _error = nullptr;
+
+      for (auto root : _roots) Schedule(*root);
+
+      {
+         std::unique_lock<std::mutex> lock(_doneLock);
+         _done.wait(lock, [this]() { return _remainingNodes == 0; });
+      }
+      if (_error) std::rethrow_exception(_error);
+   }
+
+   void Graph::Schedule(Node& node)
+   {
+      impl::AddTaskImpl(TaskPtr(&node._task), node._priority);
+   }
+
+   void Graph::RunNode(NodeId id)
+   {
+      auto& node = *_nodes[id];
+      if (!_failed)
+      {
+         try
+         {
+            node._func();
+         }
+         catch (...)
+         {
+            std::lock_guard<std::mutex> guard(_errorLock);
+            if (!_error) _error = std::current_exception();
+            _failed = true;
+         }
+      }
+
+      for (auto successor : node._successors)
+      {
+         auto& successorNode = *_nodes[successor];
+         if (--successorNode._pendingPredecessors == 0) Schedule(successorNode);
+      }
+   }
+
+   void Graph::OnNodeReleased()
+   {
+      //Decrement under the lock, otherwise Run() could see zero, return and destroy the graph before the notify
+      std::lock_guard<std::mutex> guard(_doneLock);
+      if (--_remainingNodes == 0) _done.notify_all();
+   }
+
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "TaskSystem.h"
+
+namespace task
+{
+
+   //! \brief A graph of tasks with explicit dependencies that runs on the task system. A node is started as soon as all of
+   //!        its predecessors are finished, without any barrier in between. The graph can be run repeatedly, nodes and their
+   //!        tasks are only allocated while building the graph
+   class Graph
+   {
+   public:
+      using NodeId = size_t;
+
+      Graph() = default;
+      Graph(const Graph&) = delete;
+      Graph& operator=(const Graph&) = delete;
+
+      //! \brief Adds a node to the graph
+      //! \param func Function that is executed for the node
+      //! \param priority Priority class of the node's task, latency-sensitive nodes can jump ahead of bulk work
+      //! \returns Id of the new node
+      template<typename Func>
+      NodeId AddNode(Func&& func, Priority priority = Priority::Normal)
+      {
+         return AddNodeImpl(std::function<void()>(std::forward<Func>(func)), priority);
+      }
+
+      //! \brief Adds a dependency so that 'after' is only started once 'before' is finished
+      void AddDependency(NodeId before, NodeId after);
+
+      //! \brief Runs all nodes of the graph and blocks until they are finished. Must not be called from within a task.
+      //!        Node functions may wait for other tasks (e.g. call TaskSystemParallelSort), a waiting thread keeps running
+      //!        queued tasks. If a node throws, the nodes that have not been started yet are skipped and the first
+      //!        exception is rethrown
+      //! \throws std::logic_error if the graph has a cycle
+      void Run();
+
+      size_t NumNodes() const { return _nodes.size(); }
+   private:
+      class NodeTask : public ITask
+      {
+      public:
+         NodeTask(Graph& graph, NodeId id) :
+            _graph(graph),
+            _id(id) {}
+
+         void Run() override { _graph.RunNode(_id); }
+         //! \brief Owned by the graph, so nothing is deleted here. This is the last time the task system touches the
+         //!        node, which makes it the right place to signal that the node is done
+         void Release() override { _graph.OnNodeReleased(); }
+      private:
+         Graph& _graph;
+         NodeId _id;
+      };
+
+      struct Node
+      {
+         Node(Graph& graph, NodeId id, std::function<void()> func, Priority priority) :
+            _func(std::move(func)),
+            _priority(priority),
+            _task(graph, id) {}
+
+         std::function<void()> _func;
+         Priority _priority;
+         std::vector<NodeId> _successors;
+         size_t _numPredecessors = 0;
+         std::atomic<size_t> _pendingPredecessors{ 0 };
+         NodeTask _task;
+      };
+
+      NodeId AddNodeImpl(std::function<void()> func, Priority priority);
+      void Validate();
+      void Schedule(Node& node);
+      void RunNode(NodeId id);
+      void OnNodeReleased();
+
+      std::vector<std::unique_ptr<Node>> _nodes;
+      //! \brief Nodes without predecessors, collected by Validate() so that Run() does not allocate
+      std::vector<Node*> _roots;
+      bool _validated = false;
+
+      //! \brief Guarded by _doneLock
+      size_t _remainingNodes = 0;
+      std::atomic_bool _failed{ false };
+      std::exception_ptr _error;
+      std::mutex _errorLock;
+      std::mutex _doneLock;
+      std::condition_variable _done;
+   };
+
+}
\ No newline at end of file
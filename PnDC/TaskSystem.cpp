@@ -1,7 +1,11 @@
 #include "TaskSystem.h"
 
 #include <condition_variable>
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <pthread.h>
+#endif
 
 namespace
 {
@@ -9,53 +13,89 @@ namespace
    {
       for (auto& thread : threads) thread.join();
    }
+
+   void PinToCore(std::thread& thread, size_t core)
+   {
+#ifdef _WIN32
+      SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1ull << core));
+#else
+      cpu_set_t cpuSet;
+      CPU_ZERO(&cpuSet);
+      CPU_SET(core, &cpuSet);
+      pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#endif
+   }
 }
 
 namespace task
 {
    
    std::vector<std::thread> s_threads;
-   ConcurrentQueue<std::unique_ptr<ITask>> s_tasks;
+   //! \brief One queue per priority class, indexed by Priority
+   ConcurrentQueue<TaskPtr> s_tasks[NumPriorities];
    std::atomic_bool s_runTasks;
+   size_t s_concurrency = std::thread::hardware_concurrency();
 
    std::condition_variable s_taskAwait;
    std::mutex s_taskAwaitLock;
 
+   thread_local bool s_isWorkerThread = false;
+
+   //! \brief Returns the queue with the highest priority that has tasks, or nullptr if all are empty
+   ConcurrentQueue<TaskPtr>* NextQueue()
+   {
+      for (auto& queue : s_tasks)
+      {
+         if (!queue.IsEmpty()) return &queue;
+      }
+      return nullptr;
+   }
+
    void ThreadFunc()
    {
+      s_isWorkerThread = true;
       while(s_runTasks)
       {
-         std::unique_ptr<ITask> task;
+         TaskPtr task;
 
          {
             std::unique_lock<std::mutex> lock(s_taskAwaitLock);
-            s_taskAwait.wait(lock);
-            if (s_tasks.IsEmpty()) continue;
-            task = s_tasks.Dequeue();
+            //Only sleep if there is nothing left to do, otherwise tasks that were added while all threads
+            //were busy would never be picked up
+            s_taskAwait.wait(lock, []() { return !s_runTasks || NextQueue(); });
+            auto queue = NextQueue();
+            if (!queue) continue;
+            task = queue->Dequeue();
          }
 
          task->Run();
       }
    }
 
-   void impl::AddTaskImpl(std::unique_ptr<ITask> task)
+   void impl::AddTaskImpl(TaskPtr task, Priority priority)
    {
-      s_tasks.Enqueue(std::move(task));
+      s_tasks[static_cast<size_t>(priority)].Enqueue(std::move(task));
       std::unique_lock<std::mutex> lock(s_taskAwaitLock);
       s_taskAwait.notify_one();
    }
 
    void Initialize()
+   {
+      Initialize(std::thread::hardware_concurrency(), 0);
+   }
+
+   void Initialize(size_t numThreads, size_t firstCore)
    {
       s_runTasks = true;
+      s_concurrency = numThreads;
 
-      auto maxThreads = std::thread::hardware_concurrency();
-      s_threads.reserve(maxThreads);
-      for(size_t i = 0; i < maxThreads; i++)
+      size_t numCores = std::thread::hardware_concurrency();
+      if (!numCores) numCores = 1;
+      s_threads.reserve(numThreads);
+      for(size_t i = 0; i < numThreads; i++)
       {
          s_threads.emplace_back(ThreadFunc);
-         auto handle = s_threads[i].native_handle();
-         SetThreadAffinityMask(handle, static_cast<DWORD_PTR>(1ull << i));
+         PinToCore(s_threads[i], (firstCore + i) % numCores);
       }
    }
 
@@ -67,10 +107,31 @@ namespace task
          s_taskAwait.notify_all();
       }
       JoinAll(s_threads);
+      s_threads.clear();
    }
 
    size_t GetMaxConcurrency()
    {
-      return std::thread::hardware_concurrency();
+      return s_concurrency;
+   }
+
+   bool RunPendingTask()
+   {
+      TaskPtr task;
+
+      {
+         std::unique_lock<std::mutex> lock(s_taskAwaitLock);
+         auto queue = NextQueue();
+         if (!queue) return false;
+         task = queue->Dequeue();
+      }
+
+      task->Run();
+      return true;
+   }
+
+   bool IsWorkerThread()
+   {
+      return s_isWorkerThread;
    }
 }
@@ -2,19 +2,41 @@
 #include <thread>
 #include <vector>
 #include <future>
+#include <functional>
+#include <chrono>
 
 #include "ConcurrentQueue.h"
+#include "TupleUtil.h"
 
 namespace task
 {
 
+   //! \brief Priority classes of tasks. Queued tasks of a higher priority are always started before those of a lower one
+   enum class Priority
+   {
+      High,
+      Normal,
+      Low
+   };
+
+   constexpr size_t NumPriorities = 3;
+
    class ITask
    {
    public:
       virtual ~ITask() {}
       virtual void Run() = 0;
+      //! \brief Called by the task system after Run(). Tasks that are owned by someone else can override this
+      virtual void Release() { delete this; }
    };
 
+   struct TaskReleaser
+   {
+      void operator()(ITask* task) const { task->Release(); }
+   };
+
+   using TaskPtr = std::unique_ptr<ITask, TaskReleaser>;
+
    template<typename _Task>
    class Task : public ITask
    {
@@ -72,7 +94,7 @@ namespace task
 
    namespace impl
    {
-      void AddTaskImpl(std::unique_ptr<ITask> task);
+      void AddTaskImpl(TaskPtr task, Priority priority);
    }
 
    namespace
@@ -120,7 +142,11 @@ namespace task
       };
    }
 
+   //! \brief Starts one thread per hardware thread
    void Initialize();
+   //! \brief Starts the given number of threads, pinned to consecutive cores starting at 'firstCore'. Useful when 
+   //!        several processes share one machine
+   void Initialize(size_t numThreads, size_t firstCore);
    void Shutdown();
 
    //! \brief Adds a new task to the task system
@@ -128,13 +154,13 @@ namespace task
    template<typename TaskFunc, typename... Args>
    void AddTask(TaskFunc&& taskFunc, Args&&... args)
    {
-      auto task = std::make_unique<Task<TaskFunc>>(
-         [taskFunc = std::forward<TaskFunc>(taskFunc),
+      auto func = [taskFunc = std::forward<TaskFunc>(taskFunc),
          args = std::make_tuple(std::forward<Args>(args)...)]() mutable
       {
-         InvokeFromTuple(std::forward<TaskFunc>(taskFunc), std::move(args));
-      });
-      impl::AddTaskImpl(std::move(task));
+         InvokeFromTuple(taskFunc, std::move(args));
+      };
+      auto task = std::make_unique<Task<decltype(func)>>(std::move(func));
+      impl::AddTaskImpl(TaskPtr(task.release()), Priority::Normal);
    }
 
    //! \brief Adds a new awaitable task to the task system
@@ -146,11 +172,35 @@ namespace task
       using Result_t = decltype(taskFunc(std::forward<Args>(args)...));
       auto task = MakeAwaitableTaskHelper<Result_t>::MakeTask(taskFunc, std::forward<Args>(args)...);
       auto future = task->GetFuture();
-      impl::AddTaskImpl(std::move(task));
+      impl::AddTaskImpl(TaskPtr(task.release()), Priority::Normal);
       return future;
    }
 
    //! \brief Returns the maximum number of parallel tasks that can be run in this task system
    size_t GetMaxConcurrency();
 
+   //! \brief Runs the queued task with the highest priority on the calling thread
+   //! \returns False if no task was queued
+   bool RunPendingTask();
+
+   //! \brief Returns true if the calling thread is one of the threads of the task system
+   bool IsWorkerThread();
+
+   //! \brief Waits until the future is ready. A thread of the task system keeps running queued tasks in the meantime,
+   //!        so tasks can wait for other tasks (e.g. by calling TaskSystemParallelSort) without starving the pool
+   template<typename T>
+   void Await(const std::future<T>& future)
+   {
+      if (!IsWorkerThread())
+      {
+         future.wait();
+         return;
+      }
+      while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      {
+         //Nothing to help with, the awaited task is running on another thread
+         if (!RunPendingTask()) future.wait_for(std::chrono::microseconds(50));
+      }
+   }
+
 }
\ No newline at end of file
@@ -1,9 +1,14 @@
 
 #include "Sorting.h"
 #include "ParallelUtil.h"
+#include "DataGeneration.h"
+#include "ShardedSort.h"
+#include "ArenaAllocator.h"
+#include "TaskGraph.h"
+#include "Pipeline.h"
+#include "Aggregation.h"
 
 #include <vector>
-#include <random>
 #include <numeric>
 #include <iostream>
 #include <numeric>
@@ -12,11 +17,8 @@
 
 auto RandomNumbers(size_t count)
 {
-   static std::random_device s_rnd;
-   static std::uniform_int_distribution<size_t> s_distr(0, 1000);
-   std::vector<size_t> ret(count, 0);
-   std::generate(ret.begin(), ret.end(), [&]() { return s_distr(s_rnd); });
-   return ret;
+   static uint64_t s_seed = 0;
+   return data::GenerateNumbers(count, data::Distribution::Uniform, s_seed++);
 }
 
 template<typename T>
@@ -49,6 +51,13 @@ std::ostream& operator<<(std::ostream& stream, const rt::RuntimeStats& stats)
    return stream;
 }
 
+//! \brief A record with a small key and a large payload, as in a row of a table
+struct Record
+{
+   size_t _key;
+   char _payload[120];
+};
+
 size_t ParallelSum(const std::vector<size_t>& numbers)
 {
    return ParallelDivideAndConquer(
@@ -73,13 +82,15 @@ size_t ParallelSum(const std::vector<size_t>& numbers)
 
 int main(int argc, char** argv)
 {
+   if (shard::IsWorkerProcess(argc, argv)) return shard::RunWorker(argc, argv);
+
+   task::Initialize();
+
    constexpr size_t NumberCount = 1'000'000;
    constexpr size_t Iterations = 500;
-   std::vector<std::vector<size_t>> rndNumbers;
+   std::vector<data::Numbers> rndNumbers;
    std::generate_n(std::back_inserter(rndNumbers), Iterations, [=]() { return RandomNumbers(NumberCount); });
 
-   task::Initialize();
-
    //auto sequentialSortStas = rt::CollectRuntimeStats([](auto& numbers)
    //   {
    //      SequentialSort(numbers.begin(), numbers.end());
@@ -99,12 +110,236 @@ int main(int argc, char** argv)
       [&]() mutable { auto ret = std::move(rndNumbers.back()); rndNumbers.pop_back(); return ret; },
       Iterations);
 
+   //Input and merge buffer of one iteration, plus slack for alignment. The pages are first touched by the generator tasks
+   constexpr size_t ArenaIterations = 100;
+   mem::Arena arena(2 * NumberCount * sizeof(size_t) + (4 << 20), mem::PageMode::TransparentHugePages);
+   uint64_t arenaSeed = 0;
+   auto arenaSortStats = rt::CollectRuntimeStats([&](auto& numbers)
+      {
+         TaskSystemParallelSort(numbers.begin(), numbers.end(), arena);
+      },
+      [&]() { return data::GenerateNumbers(NumberCount, data::Distribution::Uniform, arenaSeed++, mem::ArenaAllocator<size_t>(arena)); },
+      ArenaIterations);
+
+   constexpr size_t BatchIterations = 10;
+   constexpr size_t BatchArrays = 10'000;
+   constexpr size_t BatchArraySize = 5'000;
+   auto batchSortStats = rt::CollectRuntimeStats([](auto& batch)
+      {
+         BatchSort(batch);
+         for (auto& numbers : batch)
+         {
+            if (!std::is_sorted(numbers.begin(), numbers.end())) throw std::runtime_error("Batch sort produced unsorted data!");
+         }
+      },
+      [=]() 
+      { 
+         std::vector<data::Numbers> batch;
+         std::generate_n(std::back_inserter(batch), BatchArrays, [=]() { return RandomNumbers(BatchArraySize); });
+         return batch;
+      },
+      BatchIterations);
+
+   //Mostly small segments with an oversized one every 1000 segments
+   constexpr size_t SegmentedIterations = 20;
+   std::vector<size_t> segmentOffsets{ 0 };
+   while (segmentOffsets.back() < NumberCount)
+   {
+      size_t segmentSize = segmentOffsets.size() % 1000 == 0 ? 100'000 : 100;
+      segmentOffsets.push_back(std::min(NumberCount, segmentOffsets.back() + segmentSize));
+   }
+   auto segmentedSortStats = rt::CollectRuntimeStats([&](auto& numbers)
+      {
+         SegmentedSort(numbers.begin(), segmentOffsets.begin(), segmentOffsets.end());
+         for (size_t idx = 0; idx + 1 < segmentOffsets.size(); idx++)
+         {
+            if (!std::is_sorted(numbers.begin() + segmentOffsets[idx], numbers.begin() + segmentOffsets[idx + 1]))
+               throw std::runtime_error("Segmented sort produced unsorted data!");
+         }
+      },
+      [=]() { return RandomNumbers(NumberCount); },
+      SegmentedIterations);
+
+#ifdef __linux__
+   constexpr size_t ShardedIterations = 20;
+   constexpr size_t ShardWorkers = 4;
+   auto shardedSortStats = rt::CollectRuntimeStats([](auto& numbers)
+      {
+         shard::ShardedSort(numbers, ShardWorkers);
+      },
+      [=]()
+      {
+         auto numbers = RandomNumbers(NumberCount * ShardWorkers);
+         return std::vector<size_t>(numbers.begin(), numbers.end());
+      },
+      ShardedIterations);
+#endif
+
+   constexpr size_t RecordIterations = 20;
+   uint64_t recordSeed = 0;
+   auto sortByKeyStats = rt::CollectRuntimeStats([](auto& records)
+      {
+         ParallelSortByKey(records.begin(), records.end(), [](const Record& record) { return record._key; });
+         if (!std::is_sorted(records.begin(), records.end(), [](const Record& l, const Record& r) { return l._key < r._key; }))
+            throw std::runtime_error("Sort by key produced unsorted records!");
+      },
+      [&]()
+      {
+         auto keys = data::GenerateNumbers(NumberCount, data::Distribution::Uniform, recordSeed++);
+         std::vector<Record> records(NumberCount);
+         for (size_t idx = 0; idx < NumberCount; idx++) records[idx]._key = keys[idx];
+         return records;
+      },
+      RecordIterations);
+   auto sortByKeyIntoStats = rt::CollectRuntimeStats([](auto& records)
+      {
+         ParallelSortByKey(records.first.begin(), records.first.end(), records.second.begin(),
+            [](const Record& record) { return record._key; });
+         if (!std::is_sorted(records.second.begin(), records.second.end(), [](const Record& l, const Record& r) { return l._key < r._key; }))
+            throw std::runtime_error("Sort by key into output produced unsorted records!");
+      },
+      [&]()
+      {
+         auto keys = data::GenerateNumbers(NumberCount, data::Distribution::Uniform, recordSeed++);
+         std::vector<Record> records(NumberCount);
+         for (size_t idx = 0; idx < NumberCount; idx++) records[idx]._key = keys[idx];
+         return std::make_pair(std::move(records), std::vector<Record>(NumberCount));
+      },
+      RecordIterations);
+
+   constexpr size_t AggregationIterations = 20;
+   data::DistributionParams aggregationParams;
+   aggregationParams._maxValue = 1'000'000;
+   uint64_t aggregationSeed = 0;
+   auto histogramStats = rt::CollectRuntimeStats([](auto& numbers)
+      {
+         auto histogram = ParallelHistogram(numbers.begin(), numbers.end());
+         size_t total = 0;
+         for (auto& bucket : histogram) total += bucket.second;
+         if (total != numbers.size()) throw std::runtime_error("Histogram lost elements!");
+      },
+      [&]() { return data::GenerateNumbers(NumberCount, data::Distribution::Zipf, aggregationSeed++, aggregationParams); },
+      AggregationIterations);
+
+   //Count and sum per group of 16 neighbouring values
+   auto groupByStats = rt::CollectRuntimeStats([](auto& numbers)
+      {
+         auto groups = ParallelGroupBy(numbers.begin(), numbers.end(),
+            [](size_t value) { return value / 16; },
+            std::make_pair(size_t{ 0 }, size_t{ 0 }),
+            [](auto& acc, size_t value) { acc.first++; acc.second += value; },
+            [](auto& acc, const auto& other) { acc.first += other.first; acc.second += other.second; });
+         size_t total = 0;
+         for (auto& group : groups) total += group.second.first;
+         if (total != numbers.size()) throw std::runtime_error("Group-by lost elements!");
+      },
+      [&]() { return data::GenerateNumbers(NumberCount, data::Distribution::Uniform, aggregationSeed++, aggregationParams); },
+      AggregationIterations);
+
+   //One generate and one sort node per thread, so every thread of the pool is blocked in a node that waits for tasks
+   constexpr size_t GraphIterations = 20;
+   auto graphArrays = task::GetMaxConcurrency();
+   std::vector<std::vector<size_t>> graphData(graphArrays, std::vector<size_t>(NumberCount));
+   uint64_t graphSeed = 0;
+   task::Graph graph;
+   auto checkNode = graph.AddNode([&]()
+      {
+         for (auto& numbers : graphData)
+         {
+            if (!std::is_sorted(numbers.begin(), numbers.end())) throw std::runtime_error("Task graph produced unsorted data!");
+         }
+      }, task::Priority::High);
+   for (size_t idx = 0; idx < graphArrays; idx++)
+   {
+      auto generateNode = graph.AddNode([&, idx]()
+         {
+            data::GenerateInto(graphData[idx].begin(), graphData[idx].end(), data::Distribution::Uniform, graphSeed + idx);
+         });
+      auto sortNode = graph.AddNode([&, idx]() { TaskSystemParallelSort(graphData[idx].begin(), graphData[idx].end()); });
+      graph.AddDependency(generateNode, sortNode);
+      graph.AddDependency(sortNode, checkNode);
+   }
+   auto graphStats = rt::CollectRuntimeStats([&]()
+      {
+         graph.Run();
+         graphSeed += graphArrays;
+      },
+      GraphIterations);
+
+   //Streams single numbers through chunking and sorting, the aggregate counts the elements of all sorted chunks
+   constexpr size_t PipelineIterations = 20;
+   constexpr size_t PipelineChunkSize = 1 << 16;
+   uint64_t pipelineSeed = 0;
+   auto pipelineStats = rt::CollectRuntimeStats([&]()
+      {
+         pipeline::Pipeline pipeline;
+         auto seed = pipelineSeed++;
+         size_t produced = 0;
+         auto numbers = pipeline.AddSource<size_t>([&](size_t& value)
+            {
+               if (produced == NumberCount) return false;
+               value = data::CounterRng(seed, produced++).Next();
+               return true;
+            }, PipelineChunkSize);
+         auto chunks = pipeline.AddChunker(numbers, PipelineChunkSize, 4);
+         auto sortedChunks = pipeline.AddChunkedSort(chunks, 4, 4);
+         auto sortedCount = pipeline.AddAggregate(sortedChunks, size_t{ 0 },
+            [](size_t& count, std::vector<size_t>&& chunk) { if (std::is_sorted(chunk.begin(), chunk.end())) count += chunk.size(); },
+            [](size_t& total, const size_t& count) { total += count; },
+            4);
+         size_t result = 0;
+         pipeline.AddSink(sortedCount, [&](size_t count) { result = count; });
+         pipeline.Run();
+         if (result != NumberCount) throw std::runtime_error("Pipeline lost elements!");
+      },
+      PipelineIterations);
+
+   constexpr size_t DistributionIterations = 20;
+   std::vector<std::pair<data::Distribution, rt::RuntimeStats>> distributionStats;
+   for (auto distribution : data::AllDistributions)
+   {
+      uint64_t seed = 0;
+      distributionStats.push_back(std::make_pair(distribution, rt::CollectRuntimeStats([](auto& numbers)
+         {
+            TaskSystemParallelSort(numbers.begin(), numbers.end());
+         },
+         [&]() { return data::GenerateNumbers(NumberCount, distribution, seed++); },
+         DistributionIterations)));
+   }
+
    //std::cout << "######## Sequential sort stats ########\n";
    //std::cout << sequentialSortStas;
    //std::cout << "######## Parallel sort stats ########\n";
    //std::cout << parallelSortStats;
    std::cout << "######## Parallel sort with task system stats ########\n";
    std::cout << taskSystemParallelSortStats;
+   std::cout << "######## Parallel sort with task system and arena stats ########\n";
+   std::cout << arenaSortStats;
+   std::cout << "######## Batch sort stats ########\n";
+   std::cout << batchSortStats;
+   std::cout << "######## Segmented sort stats (" << segmentOffsets.size() - 1 << " segments) ########\n";
+   std::cout << segmentedSortStats;
+#ifdef __linux__
+   std::cout << "######## Sharded sort stats (" << ShardWorkers << " processes) ########\n";
+   std::cout << shardedSortStats;
+#endif
+   std::cout << "######## Sort by key stats (" << sizeof(Record) << " byte records) ########\n";
+   std::cout << sortByKeyStats;
+   std::cout << "######## Sort by key into output stats (" << sizeof(Record) << " byte records) ########\n";
+   std::cout << sortByKeyIntoStats;
+   std::cout << "######## Histogram stats (Zipf) ########\n";
+   std::cout << histogramStats;
+   std::cout << "######## Group-by stats (count and sum) ########\n";
+   std::cout << groupByStats;
+   std::cout << "######## Task graph stats (generate, sort and check " << graphArrays << " arrays) ########\n";
+   std::cout << graphStats;
+   std::cout << "######## Pipeline stats (stream, chunk, sort and aggregate) ########\n";
+   std::cout << pipelineStats;
+   for (auto& stats : distributionStats)
+   {
+      std::cout << "######## Parallel sort with task system stats (" << data::GetName(stats.first) << ") ########\n";
+      std::cout << stats.second;
+   }
 
    task::Shutdown();
 
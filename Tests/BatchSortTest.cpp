@@ -0,0 +1,83 @@
+#include "Sorting.h"
+#include "DataGeneration.h"
+#include "TaskSystem.h"
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+   //! \brief Mixes empty, single-element and small segments with oversized ones, which are split into an odd number of
+   //!        runs and merged in parallel
+   const size_t SegmentSizes[] = { 0, 1, 2, 0, 17, 1, 1000, 200'000, 0, 5'000, 3, 100'000, 1, 0, 16'385, 40'000, 7 };
+
+   bool Fail(data::Distribution distribution, const char* what)
+   {
+      std::cerr << data::GetName(distribution) << ": " << what << "\n";
+      return false;
+   }
+
+   bool CheckBatchSort(data::Distribution distribution)
+   {
+      uint64_t seed = 0;
+      std::vector<std::vector<size_t>> batch;
+      for (auto size : SegmentSizes)
+      {
+         auto numbers = data::GenerateNumbers(size, distribution, seed++);
+         batch.push_back(std::vector<size_t>(numbers.begin(), numbers.end()));
+      }
+      auto expected = batch;
+      for (auto& numbers : expected) std::sort(numbers.begin(), numbers.end());
+
+      BatchSort(batch);
+      if (batch != expected) return Fail(distribution, "batch sort differs from std::sort");
+      return true;
+   }
+
+   //! \brief Segments start after an untouched prefix and end before an untouched suffix
+   bool CheckSegmentedSort(data::Distribution distribution)
+   {
+      constexpr size_t Prefix = 11;
+      constexpr size_t Suffix = 13;
+      std::vector<size_t> offsets{ Prefix };
+      for (auto size : SegmentSizes) offsets.push_back(offsets.back() + size);
+
+      auto generated = data::GenerateNumbers(offsets.back() + Suffix, distribution, 42);
+      std::vector<size_t> numbers(generated.begin(), generated.end());
+      auto expected = numbers;
+      for (size_t idx = 0; idx + 1 < offsets.size(); idx++)
+      {
+         std::sort(expected.begin() + offsets[idx], expected.begin() + offsets[idx + 1]);
+      }
+
+      SegmentedSort(numbers.begin(), offsets.begin(), offsets.end());
+      if (numbers != expected) return Fail(distribution, "segmented sort differs from std::sort");
+
+      //Without segments nothing is touched
+      SegmentedSort(numbers.begin(), offsets.begin(), offsets.begin());
+      SegmentedSort(numbers.begin(), offsets.begin(), offsets.begin() + 1);
+      if (numbers != expected) return Fail(distribution, "segmented sort without segments changed the data");
+      return true;
+   }
+}
+
+int main()
+{
+   task::Initialize(4, 0);
+
+   bool success = true;
+   for (auto distribution : data::AllDistributions)
+   {
+      success &= CheckBatchSort(distribution);
+      success &= CheckSegmentedSort(distribution);
+   }
+
+   std::vector<std::vector<size_t>> emptyBatch;
+   BatchSort(emptyBatch);
+
+   task::Shutdown();
+
+   std::cout << (success ? "Batch sort passed\n" : "Batch sort failed\n");
+   return success ? 0 : 1;
+}
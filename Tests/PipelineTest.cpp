@@ -0,0 +1,202 @@
+#include "Pipeline.h"
+#include "TaskSystem.h"
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+
+namespace
+{
+   bool Fail(const char* what)
+   {
+      std::cerr << what << "\n";
+      return false;
+   }
+
+   //! \brief Tracks how many calls are running at the same time
+   class ConcurrencyProbe
+   {
+   public:
+      void Enter()
+      {
+         auto current = ++_current;
+         auto max = _max.load();
+         while (current > max && !_max.compare_exchange_weak(max, current)) {}
+      }
+
+      void Leave() { --_current; }
+
+      size_t Max() const { return _max; }
+   private:
+      std::atomic<size_t> _current{ 0 };
+      std::atomic<size_t> _max{ 0 };
+   };
+
+   //! \brief Source producing 0, 1, ..., count - 1
+   auto CountingSource(size_t count, size_t& next)
+   {
+      return [count, &next](size_t& value)
+      {
+         if (next == count) return false;
+         value = next++;
+         return true;
+      };
+   }
+
+   void Work()
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+   }
+
+   //! \brief The source never runs further ahead of the sink than the channel capacity plus the elements that the sink
+   //!        tasks are currently holding
+   bool CheckBackpressure()
+   {
+      constexpr size_t Count = 500;
+      constexpr size_t Capacity = 8;
+      constexpr size_t SinkParallelism = 2;
+
+      std::atomic<size_t> consumed{ 0 };
+      size_t produced = 0;
+      size_t maxAhead = 0;
+
+      pipeline::Pipeline pipeline;
+      auto numbers = pipeline.AddSource<size_t>([&](size_t& value)
+      {
+         if (produced == Count) return false;
+         value = produced++;
+         maxAhead = std::max(maxAhead, produced - consumed);
+         return true;
+      }, Capacity);
+      pipeline.AddSink(numbers, [&](size_t)
+      {
+         std::this_thread::sleep_for(std::chrono::microseconds(200));
+         consumed++;
+      }, SinkParallelism);
+      pipeline.Run();
+
+      if (consumed != Count) return Fail("Sink did not receive all elements");
+      if (maxAhead > Capacity + SinkParallelism) return Fail("Source ran further ahead than the channel capacity allows");
+      return true;
+   }
+
+   //! \brief Every stage runs up to its own in-flight limit, and never more
+   bool CheckInFlightLimits()
+   {
+      constexpr size_t Count = 200;
+      constexpr size_t TransformParallelism = 3;
+      constexpr size_t AggregateParallelism = 5;
+
+      ConcurrencyProbe transformProbe, aggregateProbe;
+      size_t next = 0;
+      pipeline::Pipeline pipeline;
+      auto numbers = pipeline.AddSource<size_t>(CountingSource(Count, next), 64);
+      auto transformed = pipeline.AddTransform(numbers, [&](size_t value)
+      {
+         transformProbe.Enter();
+         Work();
+         transformProbe.Leave();
+         return value;
+      }, TransformParallelism, 64);
+      pipeline.AddSink(transformed, [](size_t) {});
+
+      size_t otherNext = 0;
+      auto otherNumbers = pipeline.AddSource<size_t>(CountingSource(Count, otherNext), 64);
+      auto sum = pipeline.AddAggregate(otherNumbers, size_t{ 0 },
+         [&](size_t& acc, size_t value)
+         {
+            aggregateProbe.Enter();
+            Work();
+            aggregateProbe.Leave();
+            acc += value;
+         },
+         [](size_t& total, const size_t& partial) { total += partial; },
+         AggregateParallelism);
+      size_t result = 0;
+      pipeline.AddSink(sum, [&](size_t value) { result = value; });
+      pipeline.Run();
+
+      if (result != Count * (Count - 1) / 2) return Fail("Aggregate computed a wrong result");
+      if (transformProbe.Max() != TransformParallelism) return Fail("Transform did not run at its in-flight limit");
+      if (aggregateProbe.Max() != AggregateParallelism) return Fail("Aggregate did not run at its in-flight limit");
+      return true;
+   }
+
+   //! \brief Chunking, sorting and aggregating keeps every element exactly once
+   bool CheckChunkedSort()
+   {
+      constexpr size_t Count = 100'000;
+      size_t next = 0;
+      pipeline::Pipeline pipeline;
+      auto numbers = pipeline.AddSource<size_t>(CountingSource(Count, next), 1024);
+      auto shuffled = pipeline.AddTransform(numbers, [](size_t value) { return (value * 7919) % Count; }, 4, 1024);
+      auto chunks = pipeline.AddChunker(shuffled, 4096, 4);
+      auto sorted = pipeline.AddChunkedSort(chunks, 2, 4);
+      auto checked = pipeline.AddAggregate(sorted, std::make_pair(size_t{ 0 }, size_t{ 0 }),
+         [](std::pair<size_t, size_t>& acc, std::vector<size_t>&& chunk)
+         {
+            if (!std::is_sorted(chunk.begin(), chunk.end())) throw std::runtime_error("Unsorted chunk");
+            acc.first += chunk.size();
+            for (auto value : chunk) acc.second += value;
+         },
+         [](std::pair<size_t, size_t>& total, const std::pair<size_t, size_t>& partial)
+         {
+            total.first += partial.first;
+            total.second += partial.second;
+         },
+         4);
+      std::pair<size_t, size_t> result;
+      pipeline.AddSink(checked, [&](std::pair<size_t, size_t> value) { result = value; });
+      pipeline.Run();
+
+      if (result.first != Count || result.second != Count * (Count - 1) / 2) return Fail("Chunked sort lost elements");
+      return true;
+   }
+
+   //! \brief An exception in a stage stops the pipeline and is rethrown by Run()
+   bool CheckException()
+   {
+      size_t next = 0;
+      pipeline::Pipeline pipeline;
+      auto numbers = pipeline.AddSource<size_t>(CountingSource(1'000'000, next), 16);
+      auto transformed = pipeline.AddTransform(numbers, [](size_t value)
+      {
+         if (value == 1000) throw std::runtime_error("stage failed");
+         return value;
+      }, 4, 16);
+      pipeline.AddSink(transformed, [](size_t) {}, 2);
+
+      try
+      {
+         pipeline.Run();
+      }
+      catch (const std::runtime_error& e)
+      {
+         if (std::string(e.what()) != "stage failed") return Fail("Wrong exception was rethrown");
+         if (next == 1'000'000) return Fail("Source was not stopped after the exception");
+         return true;
+      }
+      return Fail("Exception of a stage was not rethrown");
+   }
+}
+
+int main()
+{
+   task::Initialize(8, 0);
+
+   bool success = true;
+   success &= CheckBackpressure();
+   success &= CheckInFlightLimits();
+   success &= CheckChunkedSort();
+   success &= CheckException();
+
+   task::Shutdown();
+
+   std::cout << (success ? "Pipeline passed\n" : "Pipeline failed\n");
+   return success ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include "ShardedSort.h"
+#include "DataGeneration.h"
+#include "TaskSystem.h"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+   //! \brief Sorts the data with ShardedSort and checks the result against std::sort
+   //! \returns True if the data is globally sorted and the offsets describe balanced, non-overlapping shards
+   bool CheckShardedSort(data::Distribution distribution, size_t count, size_t numWorkers)
+   {
+      auto numbers = data::GenerateNumbers(count, distribution, 42);
+      std::vector<size_t> sharded(numbers.begin(), numbers.end());
+      std::vector<size_t> expected(numbers.begin(), numbers.end());
+      std::sort(expected.begin(), expected.end());
+
+      auto offsets = shard::ShardedSort(sharded, numWorkers);
+
+      auto fail = [&](const char* what)
+      {
+         std::cerr << data::GetName(distribution) << ", " << numWorkers << " workers: " << what << "\n";
+         return false;
+      };
+      if (sharded != expected) return fail("data is not globally sorted");
+      if (offsets.size() != numWorkers + 1) return fail("wrong number of offsets");
+      if (offsets.front() != 0 || offsets.back() != count) return fail("offsets do not cover the data");
+      if (!std::is_sorted(offsets.begin(), offsets.end())) return fail("offsets are not ascending");
+      //Splitters come from a sample, so allow some slack. Duplicates must not collapse into one shard either
+      for (size_t worker = 0; worker < numWorkers; worker++)
+      {
+         if (offsets[worker + 1] - offsets[worker] > 2 * count / numWorkers) return fail("shards are unbalanced");
+      }
+      return true;
+   }
+
+   //! \brief A process that carries the worker marker must never spawn workers of its own
+   bool CheckRefusesInWorker()
+   {
+      std::vector<size_t> numbers{ 3, 1, 2 };
+      setenv(shard::WorkerEnvironmentVariable, "1", 1);
+      bool refused = false;
+      try
+      {
+         shard::ShardedSort(numbers, 2);
+      }
+      catch (const std::logic_error&)
+      {
+         refused = true;
+      }
+      unsetenv(shard::WorkerEnvironmentVariable);
+      if (!refused) std::cerr << "Sharded sort ran inside a worker process\n";
+      return refused;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   if (shard::IsWorkerProcess(argc, argv)) return shard::RunWorker(argc, argv);
+
+   task::Initialize();
+
+   bool success = true;
+   for (auto distribution : data::AllDistributions)
+   {
+      for (size_t numWorkers : { 1, 3, 4 })
+      {
+         success &= CheckShardedSort(distribution, 1'000'000, numWorkers);
+      }
+   }
+   success &= CheckShardedSort(data::Distribution::Uniform, 1000, 4);
+   success &= CheckRefusesInWorker();
+
+   task::Shutdown();
+
+   std::cout << (success ? "Sharded sort passed\n" : "Sharded sort failed\n");
+   return success ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#include "ShardedSort.h"
+#include "TaskSystem.h"
+
+#include <vector>
+#include <stdexcept>
+#include <iostream>
+
+//! Deliberately does not forward to shard::RunWorker(). The workers run this main() again, they have to refuse to
+//! spawn workers of their own, and the coordinator has to fail instead of waiting for them forever.
+int main()
+{
+   task::Initialize();
+
+   std::vector<size_t> numbers{ 5, 4, 3, 2, 1 };
+   int result = 1;
+   try
+   {
+      shard::ShardedSort(numbers, 2);
+   }
+   catch (const std::logic_error&)
+   {
+      //This process is one of the workers
+      result = 2;
+   }
+   catch (const std::runtime_error& e)
+   {
+      std::cout << "Sharded sort without worker passed: " << e.what() << "\n";
+      result = 0;
+   }
+
+   task::Shutdown();
+   if (result != 1) return result;
+   std::cout << "Sharded sort without worker failed: sort succeeded without workers\n";
+   return 1;
+}
@@ -0,0 +1,113 @@
+#include "Sorting.h"
+#include "DataGeneration.h"
+#include "TaskSystem.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+   //! \brief Record that remembers its original position, so the stability of the sort can be checked
+   struct Record
+   {
+      size_t _key;
+      size_t _original;
+      char _payload[48];
+   };
+
+   bool Fail(size_t count, const char* what)
+   {
+      std::cerr << count << " elements: " << what << "\n";
+      return false;
+   }
+
+   //! \brief Keys with only a few distinct values, so most records have to keep their relative order
+   std::vector<size_t> FewUniqueKeys(size_t count)
+   {
+      auto keys = data::GenerateNumbers(count, data::Distribution::FewUnique, count);
+      return std::vector<size_t>(keys.begin(), keys.end());
+   }
+
+   std::vector<Record> MakeRecords(const std::vector<size_t>& keys)
+   {
+      std::vector<Record> records(keys.size());
+      for (size_t idx = 0; idx < keys.size(); idx++)
+      {
+         records[idx]._key = keys[idx];
+         records[idx]._original = idx;
+         std::fill(std::begin(records[idx]._payload), std::end(records[idx]._payload), static_cast<char>(idx));
+      }
+      return records;
+   }
+
+   bool SameRecords(const std::vector<Record>& l, const std::vector<Record>& r)
+   {
+      return std::equal(l.begin(), l.end(), r.begin(), r.end(), [](const Record& a, const Record& b)
+      {
+         return a._key == b._key && a._original == b._original && std::equal(std::begin(a._payload), std::end(a._payload), b._payload);
+      });
+   }
+
+   bool CheckSortByKey(size_t count)
+   {
+      auto keyFunc = [](const Record& record) { return record._key; };
+      auto records = MakeRecords(FewUniqueKeys(count));
+      auto expected = records;
+      std::stable_sort(expected.begin(), expected.end(), [](const Record& l, const Record& r) { return l._key < r._key; });
+
+      std::vector<Record> sortedInto(count);
+      ParallelSortByKey(records.begin(), records.end(), sortedInto.begin(), keyFunc);
+      if (!SameRecords(sortedInto, expected)) return Fail(count, "sort by key into output differs from std::stable_sort");
+
+      ParallelSortByKey(records.begin(), records.end(), keyFunc);
+      if (!SameRecords(records, expected)) return Fail(count, "sort by key differs from std::stable_sort");
+      return true;
+   }
+
+   //! \brief Every column has to be permuted like the key column, including columns with non-trivial elements
+   bool CheckSortColumnsByKey(size_t count)
+   {
+      auto keys = FewUniqueKeys(count);
+      std::vector<size_t> originals(count);
+      std::vector<std::string> names(count);
+      for (size_t idx = 0; idx < count; idx++)
+      {
+         originals[idx] = idx;
+         names[idx] = "row " + std::to_string(idx);
+      }
+
+      std::vector<size_t> expectedOrder(count);
+      for (size_t idx = 0; idx < count; idx++) expectedOrder[idx] = idx;
+      std::stable_sort(expectedOrder.begin(), expectedOrder.end(), [&](size_t l, size_t r) { return keys[l] < keys[r]; });
+      std::vector<size_t> expectedKeys(count);
+      for (size_t idx = 0; idx < count; idx++) expectedKeys[idx] = keys[expectedOrder[idx]];
+
+      ParallelSortColumnsByKey(keys.begin(), keys.end(), originals.begin(), names.begin());
+      if (keys != expectedKeys) return Fail(count, "key column is not sorted stably");
+      if (originals != expectedOrder) return Fail(count, "column was not permuted like the keys");
+      for (size_t idx = 0; idx < count; idx++)
+      {
+         if (names[idx] != "row " + std::to_string(expectedOrder[idx])) return Fail(count, "string column was not permuted like the keys");
+      }
+      return true;
+   }
+}
+
+int main()
+{
+   task::Initialize(4, 0);
+
+   bool success = true;
+   for (size_t count : { 0, 1, 2, 1000, 4097, 300'000 })
+   {
+      success &= CheckSortByKey(count);
+      success &= CheckSortColumnsByKey(count);
+   }
+
+   task::Shutdown();
+
+   std::cout << (success ? "Sort by key passed\n" : "Sort by key failed\n");
+   return success ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include "TaskGraph.h"
+#include "TaskSystem.h"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+
+namespace
+{
+   bool Fail(const char* what)
+   {
+      std::cerr << what << "\n";
+      return false;
+   }
+
+   //! \brief Every node records when it ran, every edge has to point from an earlier to a later node
+   bool CheckDependencyOrder()
+   {
+      constexpr size_t NumNodes = 64;
+      std::atomic<size_t> clock{ 0 };
+      std::vector<size_t> finishedAt(NumNodes, 0);
+      std::vector<size_t> startedAt(NumNodes, 0);
+      std::vector<std::pair<size_t, size_t>> edges;
+
+      task::Graph graph;
+      for (size_t node = 0; node < NumNodes; node++)
+      {
+         graph.AddNode([&, node]()
+         {
+            startedAt[node] = ++clock;
+            finishedAt[node] = ++clock;
+         });
+      }
+      //Layers of diamonds: every node depends on up to two nodes of the previous layer of eight
+      for (size_t node = 8; node < NumNodes; node++)
+      {
+         edges.push_back(std::make_pair(node - 8, node));
+         edges.push_back(std::make_pair((node / 8 - 1) * 8 + (node + 3) % 8, node));
+      }
+      for (auto& edge : edges) graph.AddDependency(edge.first, edge.second);
+
+      graph.Run();
+      for (auto& edge : edges)
+      {
+         if (finishedAt[edge.first] >= startedAt[edge.second]) return Fail("Node started before its predecessor finished");
+      }
+      return true;
+   }
+
+   //! \brief With a single thread, all successors of the root are queued before any of them runs, so they have to run
+   //!        strictly by priority class
+   bool CheckPriorities()
+   {
+      std::mutex lock;
+      std::vector<task::Priority> order;
+
+      task::Graph graph;
+      auto root = graph.AddNode([]() {});
+      const task::Priority priorities[] = { task::Priority::Low, task::Priority::Normal, task::Priority::High };
+      for (size_t node = 0; node < 12; node++)
+      {
+         auto priority = priorities[node % 3];
+         auto id = graph.AddNode([&, priority]()
+         {
+            std::lock_guard<std::mutex> guard(lock);
+            order.push_back(priority);
+         }, priority);
+         graph.AddDependency(root, id);
+      }
+
+      graph.Run();
+      if (order.size() != 12) return Fail("Not all prioritized nodes ran");
+      for (size_t idx = 1; idx < order.size(); idx++)
+      {
+         if (order[idx - 1] > order[idx]) return Fail("Lower priority node ran before a higher priority one");
+      }
+      return true;
+   }
+
+   //! \brief The first exception is rethrown by Run() and the successors of the failed node are skipped
+   bool CheckException()
+   {
+      std::atomic<bool> successorRan{ false };
+      task::Graph graph;
+      auto failing = graph.AddNode([]() { throw std::runtime_error("node failed"); });
+      auto successor = graph.AddNode([&]() { successorRan = true; });
+      graph.AddDependency(failing, successor);
+
+      try
+      {
+         graph.Run();
+         return Fail("Exception of a node was not rethrown");
+      }
+      catch (const std::runtime_error& e)
+      {
+         if (std::string(e.what()) != "node failed") return Fail("Wrong exception was rethrown");
+      }
+      if (successorRan) return Fail("Successor of a failed node ran");
+      return true;
+   }
+
+   bool CheckCycle()
+   {
+      task::Graph graph;
+      auto a = graph.AddNode([]() {});
+      auto b = graph.AddNode([]() {});
+      auto c = graph.AddNode([]() {});
+      graph.AddDependency(a, b);
+      graph.AddDependency(b, c);
+      graph.AddDependency(c, b);
+      try
+      {
+         graph.Run();
+      }
+      catch (const std::logic_error&)
+      {
+         return true;
+      }
+      return Fail("Cycle was not detected");
+   }
+
+   //! \brief A graph can be run repeatedly, every node runs exactly once per Run()
+   bool CheckRepeatedRuns()
+   {
+      constexpr size_t NumRuns = 100;
+      std::vector<std::atomic<size_t>> counts(16);
+      task::Graph graph;
+      for (size_t node = 0; node < counts.size(); node++)
+      {
+         auto id = graph.AddNode([&, node]() { counts[node]++; });
+         if (node) graph.AddDependency(node / 2, id);
+      }
+      for (size_t run = 0; run < NumRuns; run++) graph.Run();
+      for (auto& count : counts)
+      {
+         if (count != NumRuns) return Fail("Node did not run exactly once per Run()");
+      }
+      return true;
+   }
+
+   //! \brief Destroys the graph right after Run() returns, the last worker must not touch it anymore
+   bool CheckDestroyAfterRun()
+   {
+      for (size_t run = 0; run < 1000; run++)
+      {
+         auto graph = std::make_unique<task::Graph>();
+         auto root = graph->AddNode([]() {});
+         for (size_t node = 0; node < 4; node++) graph->AddDependency(root, graph->AddNode([]() {}));
+         graph->Run();
+      }
+      return true;
+   }
+}
+
+int main()
+{
+   bool success = true;
+
+   task::Initialize(1, 0);
+   success &= CheckPriorities();
+   task::Shutdown();
+
+   task::Initialize(4, 0);
+   success &= CheckDependencyOrder();
+   success &= CheckException();
+   success &= CheckCycle();
+   success &= CheckRepeatedRuns();
+   success &= CheckDestroyAfterRun();
+   task::Shutdown();
+
+   std::cout << (success ? "Task graph passed\n" : "Task graph failed\n");
+   return success ? 0 : 1;
+}